@@ -0,0 +1,143 @@
+#include "CascadeModel.h"
+
+// Constructor
+/*
+*  Constructor for a cascade of a small gate tree (e.g. a depth-limited decisionTree) in front of
+*  a full random forest, both trained for the same classification task.
+*
+*  Most data points are easy: the gate's leaf already holds almost only rows of one label, and the
+*  forest would agree with it. The gate is evaluated first and answers whenever the confidence of
+*  its leaf (see decisionTree::predict) is at least the threshold, only the other data points pay
+*  for the whole forest. A threshold above 1 escalates everything (the cascade is then the forest),
+*  0 never escalates (the cascade is then the gate). calibrate picks the threshold from held-out
+*  data. The cascade counts its predictions and escalations so that the escalation rate of real
+*  traffic can be reported.
+*/
+cascadeModel::cascadeModel(decisionTree& gate_tree, randomForest& full_forest, double gate_threshold)
+{
+	gate = &gate_tree;
+	forest = &full_forest;
+	threshold = gate_threshold;
+	num_predictions = 0;
+	num_escalations = 0;
+}
+
+// Public Functions
+/*
+* Returns: - [double] the gate's label if its leaf is confident enough, else the forest's label
+*/
+double cascadeModel::predict(vd& data)
+{
+	double confidence;
+	double label = gate->predict(data, confidence);
+	num_predictions++;
+	if (confidence >= threshold) return label;
+
+	num_escalations++;
+	return forest->predict(data);
+}
+
+/*
+* Overloaded version of predict that can handle sets of data.
+*
+* Returns: - [vd] the list of predicted labels for each data point in the dataset
+*/
+vd cascadeModel::predict(vvd& dataset)
+{
+	vd predicted_labels;
+
+	for (size_t x = 0; x < dataset.size(); x++) {
+		predicted_labels.push_back(predict(dataset[x]));
+	}
+
+	return predicted_labels;
+}
+
+/*
+* Sets the lowest threshold (i.e. the one escalating the fewest data points) at which the cascade
+* still predicts the same label as the forest for at least target_agreement of the calibration
+* data. The data points are ordered by decreasing gate confidence: lowering the threshold past a
+* confidence lets the gate answer all the data points with that confidence, and the agreement can
+* only go down as more of them are answered by the gate. If even the most confident data points
+* are too far off, the threshold is set above 1 and everything is escalated.
+*
+* NOTE: the calibration data must not be part of the gate's training data, the gate's leaves are
+*       overconfident on the rows they were grown from
+*
+* Returns: - [tuple<double,double,double>] the threshold, and the agreement with the forest and the
+*            escalation rate on the calibration data at that threshold
+*/
+tuple<double,double,double> cascadeModel::calibrate(vvd& calibration_data, double target_agreement)
+{
+	size_t num_rows = calibration_data.size();
+	vd confidences(num_rows);
+	vector<bool> disagrees(num_rows);
+	vector<int> order(num_rows);
+	for (size_t x = 0; x < num_rows; x++) {
+		double gate_label = gate->predict(calibration_data[x], confidences[x]);
+		disagrees[x] = gate_label != forest->predict(calibration_data[x]);
+		order[x] = x;
+	}
+	sort(order.begin(), order.end(), [&confidences](int a, int b) { return confidences[a] > confidences[b]; });
+
+	threshold = numeric_limits<double>::infinity();
+	double agreement = 1;
+	size_t num_answered = 0;
+	size_t num_disagreements = 0;
+	size_t x = 0;
+	while (x < num_rows) {
+		// the data points with the same confidence are answered (or escalated) together
+		double confidence = confidences[order[x]];
+		size_t group_disagreements = num_disagreements;
+		size_t group_end = x;
+		while (group_end < num_rows && confidences[order[group_end]] == confidence) {
+			if (disagrees[order[group_end]]) group_disagreements++;
+			group_end++;
+		}
+		double group_agreement = 1 - group_disagreements / (double) num_rows;
+		if (group_agreement < target_agreement) break;
+
+		threshold = confidence;
+		agreement = group_agreement;
+		num_answered = group_end;
+		num_disagreements = group_disagreements;
+		x = group_end;
+	}
+	double escalation_rate = (num_rows > 0) ? (num_rows - num_answered) / (double) num_rows : 0;
+
+	return make_tuple(threshold, agreement, escalation_rate);
+}
+
+void cascadeModel::setThreshold(double gate_threshold)
+{
+	threshold = gate_threshold;
+}
+
+double cascadeModel::getThreshold()
+{
+	return threshold;
+}
+
+long long cascadeModel::getPredictionCount()
+{
+	return num_predictions;
+}
+
+long long cascadeModel::getEscalationCount()
+{
+	return num_escalations;
+}
+
+/*
+* Returns: - [double] the share of the predictions since the last resetStats that went to the forest
+*/
+double cascadeModel::getEscalationRate()
+{
+	return (num_predictions > 0) ? num_escalations / (double) num_predictions : 0;
+}
+
+void cascadeModel::resetStats()
+{
+	num_predictions = 0;
+	num_escalations = 0;
+}
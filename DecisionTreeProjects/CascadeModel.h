@@ -0,0 +1,32 @@
+#pragma once
+
+#ifndef CASCADE_MODEL_H_
+#define CASCADE_MODEL_H_
+
+#include "DecisionTree.h"
+#include "RandomForest.h"
+
+// two-stage classifier: a small gate tree answers the data points its leaf is confident about,
+// the others are escalated to the full random forest
+class cascadeModel
+{
+	decisionTree* gate; // the models must outlive the cascade
+	randomForest* forest;
+	double threshold; // the gate answers when its leaf confidence is at least this
+	long long num_predictions;
+	long long num_escalations;
+
+public:
+	cascadeModel(decisionTree&, randomForest&, double = 1);
+	double predict(vd&);
+	vd predict(vvd&);
+	tuple<double,double,double> calibrate(vvd&, double);
+	void setThreshold(double);
+	double getThreshold();
+	long long getPredictionCount();
+	long long getEscalationCount();
+	double getEscalationRate();
+	void resetStats();
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "CompactForest.h"
+
+// Constructor
+/*
+*  Constructor that compacts a trained random forest into a DAG of shared subtrees.
+*
+*  The trees of a forest trained on a small (especially discrete) dataset often contain the
+*  same subtrees, or are even entirely the same. The trees are added one by one, bottom-up,
+*  and every subtree is looked up in a hash table by its content (its split, or leaf label, and 
+*  the positions of its already deduplicated children, see subtreeHash) so that it is stored only 
+*  once, whatever the number of trees it appears in ("hash-consing"). Equal trees end up with the 
+*  same root, which is then evaluated once and carries the number of trees it stands for as its 
+*  vote weight.
+*
+*  Only what prediction needs is kept: internal nodes lose their label, frequency and error,
+*  and the child taken by values never seen in training (the most frequent child) is stored
+*  instead. Predictions are exactly those of the forest. The forest itself is not changed and
+*  is not needed by the compacted one.
+*/
+compactForest::compactForest(randomForest& trained_forest)
+{
+	is_classification = trained_forest.is_classification;
+	is_discrete = false;
+	is_multiway = false;
+	original_nodes = 0;
+	original_bytes = 0;
+	tree_weights = trained_forest.tree_weights;
+
+	unordered_map<subtreeKey,int,subtreeHash> node_ids;
+	map<int,int> root_positions;
+	for (size_t x = 0; x < trained_forest.forest.size(); x++) {
+		decisionTree& tree = trained_forest.forest[x];
+		if (x == 0) {
+			is_discrete = tree.is_discrete;
+			is_multiway = tree.is_multiway;
+			categories = tree.categories;
+		} else if (tree.is_discrete != is_discrete || tree.is_multiway != is_multiway || tree.categories != categories) {
+			wcout << L"ERROR: the trees of the forest do not split the same way, please check for errors" << endl;
+			exit(-1);
+		}
+		original_bytes += tree.nodes.size() * sizeof(node);
+
+		int root = addSubtree(tree, 0, node_ids);
+		auto inserted = root_positions.insert(make_pair(root, (int) roots.size()));
+		if (inserted.second) {
+			roots.push_back(root);
+			root_weights.push_back(0);
+		}
+		root_weights[inserted.first->second] += tree_weights.empty() ? 1 : tree_weights[x];
+		tree_roots.push_back(inserted.first->second);
+	}
+	nodes.shrink_to_fit();
+	edges.shrink_to_fit();
+	edge_values.shrink_to_fit();
+}
+
+// Private (Internal) Functions
+/*
+* Adds the subtree at node_idx of the tree, reusing the nodes already added for equal subtrees.
+*
+* Returns: - [int] the position of the subtree's root in nodes
+*/
+int compactForest::addSubtree(decisionTree& tree, int node_idx, unordered_map<subtreeKey,int,subtreeHash>& node_ids)
+{
+	const node& node_ref = tree.nodes[node_idx];
+	original_nodes++;
+
+	// the key holds everything prediction depends on, the children are already deduplicated so
+	// they are compared by their position in nodes
+	subtreeKey key;
+	key.is_leaf = node_ref.is_leaf;
+	key.split_var = -1;
+	key.value = node_ref.label;
+	key.category_mask = 0;
+	key.fallback_child = -1;
+	if (!node_ref.is_leaf) {
+		bool multiway = isMultiwayFeature(node_ref.split_var);
+		key.split_var = node_ref.split_var;
+		key.value = is_discrete ? -1 : node_ref.threshold;
+		key.fallback_child = 0;
+		if (multiway) {
+			int max_freq = -1;
+			for (int x = 0; x < node_ref.num_children; x++) {
+				if (tree.nodes[node_ref.first_child + x].frequency > max_freq) {
+					max_freq = tree.nodes[node_ref.first_child + x].frequency;
+					key.fallback_child = x;
+				}
+			}
+		} else if (is_discrete) {
+			key.fallback_child = (tree.nodes[node_ref.first_child + 1].frequency > tree.nodes[node_ref.first_child].frequency) ? 1 : 0;
+			key.category_mask = tree.nodes[node_ref.first_child].category_mask;
+		}
+		for (int x = 0; x < node_ref.num_children; x++) {
+			key.children.push_back(addSubtree(tree, node_ref.first_child + x, node_ids));
+			if (multiway) key.child_values.push_back(tree.nodes[node_ref.first_child + x].split_val);
+		}
+	}
+
+	auto found = node_ids.find(key);
+	if (found != node_ids.end()) return found->second;
+
+	compactNode compact;
+	compact.is_leaf = key.is_leaf;
+	compact.split_var = key.split_var;
+	compact.value = key.value;
+	compact.category_mask = key.category_mask;
+	compact.first_edge = edges.size();
+	compact.num_children = key.children.size();
+	compact.fallback_child = key.fallback_child;
+	compact.first_value = edge_values.size();
+	edges.insert(edges.end(), key.children.begin(), key.children.end());
+	edge_values.insert(edge_values.end(), key.child_values.begin(), key.child_values.end());
+	nodes.push_back(compact);
+	node_ids.insert(make_pair(move(key), (int) nodes.size() - 1));
+
+	return nodes.size() - 1;
+}
+
+/*
+* Follows the data point from the node at root down to a leaf, the same way decisionTree does.
+*
+* Returns: - [double] the label of the leaf
+*/
+double compactForest::predictRoot(int root, vd& data)
+{
+	const compactNode* node_ptr = &nodes[root];
+
+	while (!node_ptr->is_leaf) {
+		double data_val = data[node_ptr->split_var];
+		int child = node_ptr->fallback_child;
+		if (!is_discrete) {
+			child = (data_val < node_ptr->value) ? 0 : 1;
+		} else if (!isMultiwayFeature(node_ptr->split_var)) {
+			const vd& values = categories[node_ptr->split_var];
+			for (size_t c = 0; c < values.size(); c++) {
+				if (values[c] == data_val) {
+					child = ((node_ptr->category_mask >> c) & 1) ? 0 : 1;
+					break;
+				}
+			}
+		} else {
+			for (int x = 0; x < node_ptr->num_children; x++) {
+				if (edge_values[node_ptr->first_value + x] == data_val) {
+					child = x;
+					break;
+				}
+			}
+		}
+		node_ptr = &nodes[edges[node_ptr->first_edge + child]];
+	}
+
+	return node_ptr->value;
+}
+
+bool compactForest::isMultiwayFeature(int idx)
+{
+	return is_discrete && (is_multiway || categories[idx].empty());
+}
+
+// Public Functions
+/*
+* Returns: - [double] the predicted label for the input data, the same as the forest's
+*/
+double compactForest::predict(vd& data)
+{
+	double label = 0;
+	vd root_predictions(roots.size());
+
+	for (size_t r = 0; r < roots.size(); r++) {
+		root_predictions[r] = predictRoot(roots[r], data);
+	}
+
+	if (is_classification) {
+		map<double,double> predictions;
+		for (size_t r = 0; r < roots.size(); r++) {
+			predictions[root_predictions[r]] += root_weights[r];
+		}
+		double max_count = -1;
+		// NOTE: ties are broken the same way as in randomForest (i.e. the smallest label is chosen)
+		for (map<double, double>::iterator itr = predictions.begin(); itr != predictions.end(); ++itr) {
+			if (itr->second > max_count) {
+				label = itr->first;
+				max_count = itr->second;
+			}
+		}
+	} else {
+		// summed in tree order so the mean is exactly the forest's
+		double total_prediction = 0;
+		double total_weight = 0;
+		for (size_t x = 0; x < tree_roots.size(); x++) {
+			double weight = tree_weights.empty() ? 1 : tree_weights[x];
+			total_prediction += weight * root_predictions[tree_roots[x]];
+			total_weight += weight;
+		}
+		label = total_prediction / total_weight;
+	}
+
+	return label;
+}
+
+/*
+* Overloaded version of predict that can handle sets of data.
+*
+* Returns: - [vd] the list of predicted labels for each data point in the dataset
+*/
+vd compactForest::predict(vvd& dataset)
+{
+	vd predicted_labels;
+
+	for (size_t x = 0; x < dataset.size(); x++) {
+		predicted_labels.push_back(predict(dataset[x]));
+	}
+
+	return predicted_labels;
+}
+
+int compactForest::getTreeCount()
+{
+	return tree_roots.size();
+}
+
+int compactForest::getDistinctTreeCount()
+{
+	return roots.size();
+}
+
+int compactForest::getNodeCount()
+{
+	return nodes.size();
+}
+
+/*
+* Returns: - [int] the number of nodes of all the trees of the forest before compaction
+*/
+int compactForest::getOriginalNodeCount()
+{
+	return original_nodes;
+}
+
+/*
+* Returns: - [size_t] the memory taken by the nodes, edges and roots of the DAG
+*/
+size_t compactForest::getBytes()
+{
+	return nodes.size() * sizeof(compactNode) + edges.size() * sizeof(int) + edge_values.size() * sizeof(double)
+		+ (roots.size() + tree_roots.size()) * sizeof(int) + (root_weights.size() + tree_weights.size()) * sizeof(double);
+}
+
+/*
+* Returns: - [size_t] the memory taken by the node pools of the trees before compaction
+*/
+size_t compactForest::getOriginalBytes()
+{
+	return original_bytes;
+}
+
+bool subtreeKey::operator==(const subtreeKey& other) const
+{
+	return is_leaf == other.is_leaf && split_var == other.split_var && value == other.value && category_mask == other.category_mask 
+		&& fallback_child == other.fallback_child && children == other.children && child_values == other.child_values;
+}
+
+/*
+* Combines the hashes of every field of the key the same way as rowHash, a subtree's children are 
+* hashed by their positions in the compacted nodes rather than by their content.
+*/
+size_t subtreeHash::operator()(const subtreeKey& key) const
+{
+	size_t hash = key.is_leaf ? 1 : 0;
+
+	// adding 0.0 turns -0.0 into 0.0, which compares equal to it
+	hash ^= std::hash<int>()(key.split_var) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<double>()(key.value + 0.0) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<uint64_t>()(key.category_mask) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<int>()(key.fallback_child) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	for (size_t x = 0; x < key.children.size(); x++) {
+		hash ^= std::hash<int>()(key.children[x]) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+	for (size_t x = 0; x < key.child_values.size(); x++) {
+		hash ^= std::hash<double>()(key.child_values[x] + 0.0) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	return hash;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef COMPACT_FOREST_H_
+#define COMPACT_FOREST_H_
+
+#include "RandomForest.h"
+#include <unordered_map>
+
+// a node of the DAG shared by the trees of a compacted forest
+struct compactNode
+{
+	bool is_leaf;
+	int split_var;
+	double value; // the label of a leaf, or the threshold of a continuous split
+	uint64_t category_mask; // NOTE: only used with partition splits, the categories that lead to the first child
+	int first_edge; // position of the node's first child in the edge list, the children are contiguous
+	int first_value; // NOTE: only used with multiway splits, position of the value leading to the node's first child in edge_values
+	int num_children;
+	int fallback_child; // NOTE: only used in discrete data, the child followed by values never seen in training
+};
+
+// what prediction depends on in a subtree, the key of the table of distinct subtrees
+struct subtreeKey
+{
+	bool is_leaf;
+	int split_var; // -1 for a leaf
+	double value; // the label of a leaf, or the threshold of a continuous split (-1 for discrete splits)
+	uint64_t category_mask; // NOTE: only used with partition splits
+	int fallback_child; // NOTE: only used in discrete data, -1 for a leaf
+	vector<int> children; // positions in the compacted nodes of the (already deduplicated) children
+	vd child_values; // NOTE: only used with multiway splits, the value leading to each child
+
+	bool operator==(const subtreeKey&) const;
+};
+
+struct subtreeHash
+{
+	size_t operator()(const subtreeKey&) const;
+};
+
+class compactForest
+{
+	vector<compactNode> nodes; // the distinct subtrees of the forest, children come before their parents
+	vector<int> edges; // positions in nodes of the children of every node
+	vd edge_values; // NOTE: only used with multiway splits, the value of the split variable leading to each child
+	vector<int> roots; // the distinct trees
+	vd root_weights; // the number of trees of the forest equal to each distinct tree (the sum of their weights)
+	vector<int> tree_roots; // position in roots of every tree of the forest, in order
+	vd tree_weights; // the weights of the forest's trees, empty when every tree counts once
+	vvd categories; // NOTE: only used with partition splits, see decisionTree (empty for the features split multiway)
+	bool is_discrete;
+	bool is_multiway;
+	bool is_classification;
+	int original_nodes;
+	size_t original_bytes;
+
+	int addSubtree(decisionTree&, int, unordered_map<subtreeKey,int,subtreeHash>&);
+	double predictRoot(int, vd&);
+	bool isMultiwayFeature(int);
+
+public:
+	compactForest(randomForest&);
+	double predict(vd&);
+	vd predict(vvd&);
+	int getTreeCount();
+	int getDistinctTreeCount();
+	int getNodeCount();
+	int getOriginalNodeCount();
+	size_t getBytes();
+	size_t getOriginalBytes();
+};
+
+#endif
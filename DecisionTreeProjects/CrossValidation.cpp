@@ -0,0 +1,234 @@
+#include "CrossValidation.h"
+
+// Constructor
+/*
+*  Prepares a k-fold cross-validation run over an already parsed dataset.
+*
+*  The folds are split once here and every setting passed to gridSearch reuses the same fold 
+*  datasets. For continuous data the candidate split thresholds are also binned once per fold, 
+*  from that fold's training rows only (see decisionTree::getBinnedThresholds), and shared by 
+*  every tree of every setting on that fold, so no tree has to sort its columns at each node 
+*  and no tree splits on thresholds taken from the rows it is scored on.
+*/
+crossValidator::crossValidator(vvd& dataset, int folds, bool discrete, bool classification, int threads, unsigned int cv_seed)
+{
+	if (folds < 2 || (size_t) folds > dataset.size()) {
+		wcout << L"ERROR: invalid number of folds for cross-validation, please check the program call" << endl;
+		exit(-1);
+	}
+	num_folds = folds;
+	is_discrete = discrete;
+	is_classification = classification;
+	seed = cv_seed;
+	num_threads = (threads > 0) ? threads : max(1, (int) thread::hardware_concurrency());
+
+	splitFolds(dataset);
+	if (!is_discrete) {
+		fold_binned_thresholds.resize(num_folds);
+		for (int f = 0; f < num_folds; f++) {
+			fold_binned_thresholds[f] = decisionTree::getBinnedThresholds(fold_train_data[f], 64);
+		}
+	}
+}
+
+// Private (Internal) Functions
+void crossValidator::splitFolds(vvd& dataset)
+{
+	vector<int> order;
+	for (size_t x = 0; x < dataset.size(); x++) {
+		order.push_back(x);
+	}
+	mt19937 shuffle_rng(seed);
+	shuffle(order.begin(), order.end(), shuffle_rng);
+
+	fold_train_data.assign(num_folds, vvd());
+	fold_test_data.assign(num_folds, vvd());
+	fold_test_labels.assign(num_folds, vd());
+	for (size_t x = 0; x < order.size(); x++) {
+		int test_fold = x % num_folds;
+		vd& row = dataset[order[x]];
+		for (int f = 0; f < num_folds; f++) {
+			if (f == test_fold) {
+				fold_test_data[f].push_back(vd(row.begin(), row.end() - 1));
+				fold_test_labels[f].push_back(row[row.size() - 1]);
+			} else {
+				fold_train_data[f].push_back(row);
+			}
+		}
+	}
+}
+
+double crossValidator::runFold(hyperParams& params, int fold, double& train_seconds, double& predict_seconds)
+{
+	vvd& train_data = fold_train_data[fold];
+	vvd& test_data = fold_test_data[fold];
+
+	treeOptions options;
+	options.seed = randomForest::getTreeSeed(seed, fold);
+	options.min_data_size = params.min_data_size;
+	options.verbose = false;
+	options.extra_trees = params.extra_trees;
+	options.bootstrap = !params.extra_trees;
+	if (!is_discrete) options.binned_thresholds = &fold_binned_thresholds[fold];
+
+	vd predictions;
+	auto train_start = chrono::steady_clock::now();
+	if (params.use_forest) {
+		int bag_size = (params.bag_size > 0) ? min(params.bag_size, (int) train_data.size()) : train_data.size();
+		randomForest forest(train_data, params.forest_size, bag_size, is_discrete, is_classification, options);
+		auto predict_start = chrono::steady_clock::now();
+		predictions = forest.predict(test_data);
+		auto predict_end = chrono::steady_clock::now();
+		train_seconds = chrono::duration<double>(predict_start - train_start).count();
+		predict_seconds = chrono::duration<double>(predict_end - predict_start).count();
+	} else {
+		int data_cutoff = (params.min_data_size > 0) ? params.min_data_size : (int) sqrt(train_data.size());
+		decisionTree tree(train_data, data_cutoff, is_discrete, is_classification, false, options);
+		auto predict_start = chrono::steady_clock::now();
+		predictions = tree.predict(test_data);
+		auto predict_end = chrono::steady_clock::now();
+		train_seconds = chrono::duration<double>(predict_start - train_start).count();
+		predict_seconds = chrono::duration<double>(predict_end - predict_start).count();
+	}
+
+	return scorePredictions(fold_test_labels[fold], predictions);
+}
+
+/*
+* Returns: - [double] accuracy for classification, root mean squared error for regression
+*/
+double crossValidator::scorePredictions(vd& test_labels, vd& test_predictions)
+{
+	double total = 0;
+
+	for (size_t x = 0; x < test_labels.size(); x++) {
+		if (is_classification) {
+			if (test_labels[x] == test_predictions[x]) total++;
+		} else {
+			double diff = test_labels[x] - test_predictions[x];
+			total += diff * diff;
+		}
+	}
+
+	if (is_classification) return total / test_labels.size();
+	return sqrt(total / test_labels.size());
+}
+
+// Public Functions
+/*
+* Evaluates every setting on every fold. The (setting, fold) pairs are handed out to a pool of 
+* worker threads, each model is seeded from the cross-validation seed and its fold so the 
+* results do not depend on the number of threads or the order the work is picked up in.
+*
+* Returns: - [vector<cvResult>] the metrics and timing of each setting, in the order given
+*/
+vector<cvResult> crossValidator::gridSearch(vector<hyperParams>& grid)
+{
+	int num_tasks = grid.size() * num_folds;
+	vvd scores(grid.size(), vd(num_folds));
+	vvd train_times(grid.size(), vd(num_folds));
+	vvd predict_times(grid.size(), vd(num_folds));
+
+	atomic<int> next_task(0);
+	auto worker = [&]() {
+		for (int task = next_task++; task < num_tasks; task = next_task++) {
+			int setting = task / num_folds;
+			int fold = task % num_folds;
+			scores[setting][fold] = runFold(grid[setting], fold, train_times[setting][fold], predict_times[setting][fold]);
+		}
+	};
+	vector<thread> workers;
+	for (int t = 0; t < min(num_threads, num_tasks); t++) {
+		workers.push_back(thread(worker));
+	}
+	for (size_t t = 0; t < workers.size(); t++) {
+		workers[t].join();
+	}
+
+	vector<cvResult> results;
+	for (size_t s = 0; s < grid.size(); s++) {
+		cvResult result;
+		result.params = grid[s];
+		result.fold_scores = scores[s];
+		result.mean_score = 0;
+		result.train_seconds = 0;
+		result.predict_seconds = 0;
+		for (int f = 0; f < num_folds; f++) {
+			result.mean_score += scores[s][f] / num_folds;
+			result.train_seconds += train_times[s][f];
+			result.predict_seconds += predict_times[s][f];
+		}
+		double variance = 0;
+		for (int f = 0; f < num_folds; f++) {
+			variance += (scores[s][f] - result.mean_score) * (scores[s][f] - result.mean_score) / num_folds;
+		}
+		result.std_score = sqrt(variance);
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+void crossValidator::printResults(vector<cvResult>& results)
+{
+	size_t best_idx = 0;
+	for (size_t x = 1; x < results.size(); x++) {
+		bool is_better = is_classification ? (results[x].mean_score > results[best_idx].mean_score) 
+			: (results[x].mean_score < results[best_idx].mean_score);
+		if (is_better) best_idx = x;
+	}
+
+	wcout << L"Cross-Validation Results (" << num_folds << L" folds, " << num_threads << L" threads):\n";
+	wcout << L"----------------------------------------------------------------\n";
+	wcout << setw(2) << L"#" << setw(8) << L"Model" << setw(10) << L"Min Data" << setw(8) << L"Trees" << setw(8) << L"Bag" 
+		<< setw(12) << (is_classification ? L"Accuracy" : L"RMSE") << setw(10) << L"Std Dev" << setw(12) << L"Train (s)" << setw(13) << L"Predict (s)\n";
+	for (size_t x = 0; x < results.size(); x++) {
+		hyperParams& params = results[x].params;
+		wcout << setw(2) << x + 1 << setw(8) << (params.use_forest ? (params.extra_trees ? L"extra" : L"forest") : L"tree") << setw(10) << params.min_data_size;
+		if (params.use_forest) {
+			wcout << setw(8) << params.forest_size << setw(8) << params.bag_size;
+		} else {
+			wcout << setw(8) << L"-" << setw(8) << L"-";
+		}
+		wcout << setw(12) << results[x].mean_score << setw(10) << results[x].std_score 
+			<< setw(12) << results[x].train_seconds << setw(13) << results[x].predict_seconds;
+		if (x == best_idx) wcout << L"  <--- best";
+		wcout << "\n";
+	}
+	wcout << L"----------------------------------------------------------------" << endl;
+}
+
+/*
+* Builds a dozen settings around the defaults used by the tester: standalone trees with a range 
+* of cut-offs around sqrt(n), forests with a few tree counts and bag sizes, and extremely 
+* randomized forests with the same tree counts for comparison.
+*
+* Returns: - [vector<hyperParams>] the default grid for a dataset of the given size
+*/
+vector<hyperParams> crossValidator::getDefaultGrid(int data_size)
+{
+	vector<hyperParams> grid;
+	int root_size = max(1, (int) sqrt(data_size));
+
+	int tree_cutoffs[] = { 2, max(2, root_size / 2), root_size, root_size * 2 };
+	for (int cutoff : tree_cutoffs) {
+		grid.push_back({ cutoff, false, 0, 0, false });
+	}
+	int forest_sizes[] = { 50, 200 };
+	int bag_sizes[] = { max(10, data_size / 5), -1 };
+	int forest_cutoffs[] = { max(2, root_size / 2), root_size };
+	for (int forest_size : forest_sizes) {
+		for (int bag_size : bag_sizes) {
+			for (int cutoff : forest_cutoffs) {
+				grid.push_back({ cutoff, true, forest_size, bag_size, false });
+			}
+		}
+	}
+	for (int forest_size : forest_sizes) {
+		for (int cutoff : forest_cutoffs) {
+			grid.push_back({ cutoff, true, forest_size, -1, true });
+		}
+	}
+
+	return grid;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef CROSS_VALIDATION_H_
+#define CROSS_VALIDATION_H_
+
+#include "RandomForest.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+// a single point in the hyperparameter grid
+struct hyperParams
+{
+	int min_data_size; // -1 defaults to sqrt of the training fold size
+	bool use_forest;
+	int forest_size;
+	int bag_size; // -1 defaults to the training fold size
+	bool extra_trees; // NOTE: only used by forests, extremely randomized trees trained without bootstrapping
+};
+
+// per-setting metrics (accuracy for classification, RMSE for regression) and timing
+struct cvResult
+{
+	hyperParams params;
+	vd fold_scores;
+	double mean_score;
+	double std_score;
+	double train_seconds; // summed over folds
+	double predict_seconds; // summed over folds
+};
+
+class crossValidator
+{
+	vector<vvd> fold_train_data;
+	vector<vvd> fold_test_data;
+	vector<vd> fold_test_labels;
+	vector<vvd> fold_binned_thresholds; // NOTE: only used in continuous data, computed from each fold's training rows
+	int num_folds;
+	int num_threads;
+	bool is_discrete;
+	bool is_classification;
+	unsigned int seed;
+
+	void splitFolds(vvd&);
+	double runFold(hyperParams&, int, double&, double&);
+	double scorePredictions(vd&, vd&);
+
+public:
+	crossValidator(vvd&, int, bool, bool, int, unsigned int);
+	vector<cvResult> gridSearch(vector<hyperParams>&);
+	void printResults(vector<cvResult>&);
+	static vector<hyperParams> getDefaultGrid(int);
+};
+
+#endif
@@ -1,536 +1,1581 @@
 #include "DecisionTree.h"
+#include "Scoring.h"
+#include "SparseData.h"
 
 // Constructor
 /*
 *  Constructor for a decision tree object.
 *
 *  There are a few key components/member "structures" to note:
-*    - data_info:
-*      Scans input data and notes the unique values in each column of input data.
-*      so, ---           ---
-*          | [ a b ... c ] | <--- column 1 unique values
-*          | [ d e ... f ] | <--- column 2 unique values
-*          | etc.          |
-*          .               .
-*          .               .
-*          .               .
-*          |               |
-*          ---           ---
+*    - nodes:
+*      Pool holding every node of the tree, the root is the first node and the children of a
+*      node are stored next to each other (first_child, num_children). Growing the tree only
+*      appends to this one vector.
+*      so, ---                                        ---
+*          | [ root | root children | child 1 children ... ] |
+*          ---                                        ---
 *
-*    - label_info:
-*      Dictionary structure that maps each unique label the occurs w/ the number of occurrences.
-*      so, ( [ x --- y ] ) <--- label 1
-*          ( [ w --- z ] ) <--- label 2
-*          ( etc.        )
-*          .             .
-*          .             .
-*          .             .
-*          (             )
+*    - workspace:
+*      Scratch space used while the tree grows (see treeWorkspace). The training rows are never
+*      copied, the tree works on a list of row positions that is partitioned in place so that
+*      every node owns a contiguous range of it, and the discrete values and the class labels
+*      are encoded once per dataset instead of being rescanned at every node. Duplicate rows
+*      (and the repeats of a bootstrap sample) are collapsed into one weighted row, so the
+*      work done at every node grows with the number of distinct rows. Forests and boosting
+*      hand the same workspace to all of their trees through treeOptions, so its buffers are
+*      only allocated for the first tree.
 *
+*
+*  For classification the splits maximize information gain, for regression they maximize the 
+*  reduction in label variance and the leaves predict the mean label.
+*
+*  Discrete features are split into two groups of values (see bestCategoryPartition) and stay 
+*  available deeper in the tree, a node tests a value's bit in the category_mask of its first 
+*  child. The treeOptions can switch back to multiway splits (one child per value, the feature 
+*  is then used up). A feature with more than 64 distinct values does not fit in the masks and 
+*  always gets multiway splits, the other features of the tree keep their partition splits.
+*
+*  The optional treeOptions argument can limit the depth of the tree, switch to best-first growth 
+*  under a leaf/memory budget (see buildTreeBestFirst), seeds the node sampling done when the tree is part of a forest 
+*  and can supply binned thresholds (see getBinnedThresholds) that replace the per-node sort of 
+*  continuous columns, or switch to the random splits of extremely randomized trees (see 
+*  randomSplitVar). It can also restrict training to a list of rows of the dataset (e.g. a
+*  bootstrap sample) so that callers do not have to copy them.
 */
-decisionTree::decisionTree(vvd& train_dataset, int data_cutoff, bool discrete, bool classification, bool forest)
+decisionTree::decisionTree(vvd& train_dataset, int data_cutoff, bool discrete, bool classification, bool forest, treeOptions options)
 {
 	is_discrete = discrete;
 	is_classification = classification;
 	is_in_forest = forest;
 	min_data_size = data_cutoff;
-    if (is_discrete) data_info = getDatasetInfo(train_dataset);
-	labels = getLabelInfo(train_dataset);
+	max_depth = options.max_depth;
+	max_leaves = options.max_leaves;
+	max_bytes = options.max_bytes;
+	binned_thresholds = options.binned_thresholds;
+	extra_trees = options.extra_trees;
+	rng.seed(options.seed);
 
-	vector<int> original_indices;
+	treeWorkspace local_workspace;
+	workspace = (options.workspace != nullptr) ? options.workspace : &local_workspace;
+	train_data = &train_dataset;
+	prepareWorkspace(train_dataset, options.sample_rows, options.collapse_rows);
+	is_multiway = options.multiway_splits;
+	if (is_discrete && !is_multiway) {
+		categories = workspace->categories;
+		for (size_t y = 0; y < categories.size(); y++) {
+			if (categories[y].size() > 64) categories[y].clear();
+		}
+	}
+
+	vector<int> features;
 	for (size_t y = 0; y < train_dataset[0].size() - 1; y++) {
-		original_indices.push_back(y);
+		features.push_back(y);
+	}
+	nodes.push_back(node());
+	nodes[0].frequency = (options.sample_rows != nullptr) ? options.sample_rows->size() : train_dataset.size();
+	if (options.best_first) {
+		buildTreeBestFirst(features);
+	} else {
+		buildTree(0, workspace->rows.size(), features, 0, 0);
+	}
+	nodes.shrink_to_fit();
+
+	workspace = nullptr;
+	train_data = nullptr;
+}
+
+/*
+*  Constructor for a continuous decision tree trained on sparse data (e.g. wide one-hot encoded 
+*  features), with the labels given separately.
+*
+*  Split search gathers the non-zero entries of a node through the CSR rows it owns and buckets 
+*  them by column, so only the columns that are non-zero somewhere in the node are visited, and 
+*  the zero entries' label counts (or sums) are derived from the node's totals. The work per node 
+*  therefore grows with the node's own non-zeros rather than rows x columns (or the non-zeros of 
+*  the whole matrix). The resulting tree is an ordinary continuous tree: it predicts sparse rows as 
+*  well as dense ones, and can be pruned like any other tree. Best-first growth and forests are 
+*  not supported on sparse data.
+*/
+decisionTree::decisionTree(csrMatrix& train_dataset, vd& train_labels, int data_cutoff, bool classification, treeOptions options)
+{
+	is_discrete = false;
+	is_classification = classification;
+	is_in_forest = false;
+	is_multiway = false;
+	extra_trees = false;
+	min_data_size = data_cutoff;
+	max_depth = options.max_depth;
+	max_leaves = options.max_leaves;
+	max_bytes = options.max_bytes;
+	binned_thresholds = nullptr;
+	rng.seed(options.seed);
+	train_data = nullptr;
+	workspace = nullptr;
+
+	sparseContext context;
+	context.data = &train_dataset;
+	context.labels = train_labels;
+	context.col_counts.assign(train_dataset.num_cols, 0);
+	if (is_classification) {
+		context.class_values = train_labels;
+		sort(context.class_values.begin(), context.class_values.end());
+		context.class_values.erase(unique(context.class_values.begin(), context.class_values.end()), context.class_values.end());
+		for (size_t x = 0; x < train_labels.size(); x++) {
+			context.row_classes.push_back(lower_bound(context.class_values.begin(), context.class_values.end(), train_labels[x]) - context.class_values.begin());
+		}
 	}
-	node root;
-	root.frequency = train_dataset.size();
-	root_node = buildTree(train_dataset, original_indices, root);
-	/*
-	if (!is_in_forest) {
-		root_node = pruneTree();
+
+	for (int x = 0; x < train_dataset.num_rows; x++) {
+		context.rows.push_back(x);
+	}
+	context.row_buffer.resize(context.rows.size());
+	nodes.push_back(node());
+	nodes[0].frequency = context.rows.size();
+	buildSparseTree(context, 0, context.rows.size(), 0, 0);
+	nodes.shrink_to_fit();
+}
+
+/*
+*  Constructor that reads back a tree written by save. Only what prediction and pruning need is 
+*  stored (the settings used during training are not), so a loaded tree predicts exactly like 
+*  the saved one.
+*/
+decisionTree::decisionTree(istream& input)
+{
+	min_data_size = -1;
+	max_depth = -1;
+	max_leaves = -1;
+	max_bytes = 0;
+	is_in_forest = false;
+	extra_trees = false;
+	binned_thresholds = nullptr;
+	train_data = nullptr;
+	workspace = nullptr;
+
+	string tag;
+	size_t num_nodes = 0;
+	size_t num_features = 0;
+	input >> tag >> is_discrete >> is_classification >> is_multiway >> num_nodes >> num_features;
+	if (!input || tag != "tree") {
+		wcout << L"ERROR: invalid tree in model file, please check for errors" << endl;
+		exit(-1);
+	}
+	categories.resize(num_features);
+	for (size_t y = 0; y < num_features; y++) {
+		size_t num_categories = 0;
+		input >> num_categories;
+		categories[y].resize(num_categories);
+		for (size_t c = 0; c < num_categories; c++) {
+			input >> categories[y][c];
+		}
+	}
+	nodes.resize(num_nodes);
+	for (size_t x = 0; x < num_nodes; x++) {
+		node& node_ref = nodes[x];
+		input >> node_ref.is_leaf >> node_ref.label >> node_ref.split_var >> node_ref.split_val >> node_ref.threshold 
+			>> node_ref.frequency >> node_ref.error >> node_ref.first_child >> node_ref.num_children >> node_ref.category_mask;
+	}
+	if (!input || num_nodes == 0) {
+		wcout << L"ERROR: invalid tree in model file, please check for errors" << endl;
+		exit(-1);
 	}
-	*/
 }
 
 // Private (Internal) Functions
-node decisionTree::buildTree(vvd& input_data, vector<int> indices, node node_ref)
+/*
+* Encodes the dataset into the workspace (unless the workspace already holds its encoding) and
+* resets the list of rows to train on. Discrete values are replaced by their position in the
+* column's sorted list of distinct values and class labels by their position in the sorted list 
+* of distinct labels, so that the per-node counts can index arrays instead of searching.
+*
+* If collapse is set, the rows to train on are reduced to their distinct rows (same features and
+* label), each weighted by the number of rows it stands for, and every count of the tree (split
+* statistics, leaf labels and errors, node frequencies) adds up these weights. The tree is the
+* same as the one trained on all the rows, but a dataset with many duplicates, or a bootstrap
+* sample with its repeats, costs as much as its distinct rows. The rows are hashed by their
+* features once per dataset (the labels can change between the trees of gradient boosting), the
+* labels are then compared within each group of equal features.
+*/
+void decisionTree::prepareWorkspace(vvd& train_dataset, const vector<int>* sample_rows, bool collapse)
 {
+	treeWorkspace& ws = *workspace;
+	size_t label_idx = train_dataset[0].size() - 1;
+
+	if (ws.encoded_data != &train_dataset) {
+		ws.categories.assign(is_discrete ? label_idx : 0, vd());
+		ws.row_codes.assign(is_discrete ? label_idx : 0, vector<int>(train_dataset.size()));
+		size_t max_categories = 2;
+		for (size_t y = 0; y < ws.categories.size(); y++) {
+			map<double,int> codes;
+			for (size_t x = 0; x < train_dataset.size(); x++) {
+				codes.insert(make_pair(train_dataset[x][y], 0));
+			}
+			for (auto& code : codes) {
+				code.second = ws.categories[y].size();
+				ws.categories[y].push_back(code.first);
+			}
+			for (size_t x = 0; x < train_dataset.size(); x++) {
+				ws.row_codes[y][x] = codes[train_dataset[x][y]];
+			}
+			max_categories = max(max_categories, ws.categories[y].size());
+		}
+		ws.code_positions.assign(max_categories, -1);
+
+		ws.class_values.clear();
+		ws.row_classes.clear();
+		if (is_classification) {
+			for (size_t x = 0; x < train_dataset.size(); x++) {
+				ws.class_values.push_back(train_dataset[x][label_idx]);
+			}
+			sort(ws.class_values.begin(), ws.class_values.end());
+			ws.class_values.erase(unique(ws.class_values.begin(), ws.class_values.end()), ws.class_values.end());
+			for (size_t x = 0; x < train_dataset.size(); x++) {
+				ws.row_classes.push_back(lower_bound(ws.class_values.begin(), ws.class_values.end(), train_dataset[x][label_idx]) - ws.class_values.begin());
+			}
+		}
+		ws.feature_groups.clear();
+		ws.encoded_data = &train_dataset;
+	}
+
+	size_t num_rows = (sample_rows != nullptr) ? sample_rows->size() : train_dataset.size();
+	ws.sample_weights.assign(train_dataset.size(), 0);
+	if (!collapse) {
+		ws.row_weights.assign(train_dataset.size(), 1);
+		ws.weights = ws.row_weights.data();
+		if (sample_rows != nullptr) {
+			ws.rows.assign(sample_rows->begin(), sample_rows->end());
+		} else {
+			ws.rows.resize(num_rows);
+			for (size_t x = 0; x < num_rows; x++) {
+				ws.rows[x] = x;
+			}
+		}
+	} else {
+		if (ws.feature_groups.size() != train_dataset.size()) {
+			rowHash hasher = { &train_dataset };
+			rowEqual comparer = { &train_dataset };
+			unordered_set<int, rowHash, rowEqual> distinct_rows(train_dataset.size(), hasher, comparer);
+			ws.feature_groups.resize(train_dataset.size());
+			for (size_t x = 0; x < train_dataset.size(); x++) {
+				ws.feature_groups[x] = *distinct_rows.insert(x).first;
+			}
+			ws.group_heads.assign(train_dataset.size(), -1);
+			ws.next_duplicate.assign(train_dataset.size(), -1);
+		}
+
+		// the distinct rows are kept in order of first appearance, so the tree splits them in the 
+		// same order as all the rows
+		ws.row_weights.assign(train_dataset.size(), 0);
+		ws.weights = ws.row_weights.data();
+		ws.rows.clear();
+		for (size_t x = 0; x < num_rows; x++) {
+			int row = (sample_rows != nullptr) ? (*sample_rows)[x] : x;
+			int group = ws.feature_groups[row];
+			int distinct_row = ws.group_heads[group];
+			while (distinct_row != -1 && train_dataset[distinct_row][label_idx] != train_dataset[row][label_idx]) {
+				distinct_row = ws.next_duplicate[distinct_row];
+			}
+			if (distinct_row == -1) {
+				distinct_row = row;
+				ws.next_duplicate[row] = ws.group_heads[group];
+				ws.group_heads[group] = row;
+				ws.rows.push_back(row);
+			}
+			ws.row_weights[distinct_row]++;
+		}
+		for (size_t x = 0; x < ws.rows.size(); x++) {
+			ws.group_heads[ws.feature_groups[ws.rows[x]]] = -1;
+		}
+	}
+	ws.row_buffer.resize(ws.rows.size());
+	ws.row_marks.assign(num_rows, 0);
+	ws.child_bounds.clear();
+}
+
+/*
+* Grows the subtree at node_idx from the rows in [start, end) of the workspace, depth-first.
+* features lists the (original) positions of the features that can still be split on.
+*/
+void decisionTree::buildTree(size_t start, size_t end, vector<int>& features, int node_idx, int depth)
+{
+	auto split_info = findNodeSplit(start, end, features, node_idx, depth);
+	int split_var = get<0>(split_info);
+	if (split_var == -1) return;
+
+	// choose how to split based on if the data is discrete or continuous
+	// for reference:
+	//   - discrete - split the values of that variable into the two groups of the best 
+	//                partition (or, with multiway splits, on all possible values)
+	//   - continuous - find the best threshold for that variable and make a 
+	//                  binary split
+	uint64_t category_mask = workspace->split_mask;
+	size_t bounds_base = workspace->child_bounds.size();
+	int num_children = partitionRows(start, end, split_var, get<1>(split_info), category_mask);
+	addChildren(node_idx, split_var, get<1>(split_info), category_mask, bounds_base, num_children);
+
+	// with multiway splits a discrete feature is used up by the split, it is put back once the 
+	// subtree is done
+	bool uses_up_feature = isMultiwayFeature(split_var);
+	ptrdiff_t feature_pos = 0;
+	if (uses_up_feature) {
+		feature_pos = distance(features.begin(), find(features.begin(), features.end(), split_var));
+		features.erase(features.begin() + feature_pos);
+	}
+	int first_child = nodes[node_idx].first_child;
+	for (int x = 0; x < num_children; x++) {
+		buildTree(workspace->child_bounds[bounds_base + x], workspace->child_bounds[bounds_base + x + 1], features, first_child + x, depth + 1);
+	}
+	if (uses_up_feature) features.insert(features.begin() + feature_pos, split_var);
+	workspace->child_bounds.resize(bounds_base);
+}
+
+/*
+* Alternative to buildTree that grows the tree leaf-wise: every leaf that can be split is kept 
+* in a priority queue ordered by the gain of its best split (weighted by its data size, i.e. the 
+* total reduction in entropy or variance), and the best one is expanded until no leaf is left 
+* or the next expansion would exceed max_leaves or max_bytes. Depth limits, the minimum data 
+* size and the leaf checks apply exactly as in buildTree, so without any budget a standalone 
+* tree comes out the same as the depth-first one. The memory budget only counts the nodes 
+* themselves (sizeof(node) each), not the workspace used during training.
+*
+* The tree is valid at every step since each node is created as a leaf (with its majority or 
+* mean label) and only turned into an internal node when it is expanded.
+*/
+void decisionTree::buildTreeBestFirst(vector<int>& features)
+{
+	int num_leaves = 1;
+	size_t num_bytes = sizeof(node);
+
+	vector<pendingLeaf> queue;
+	pendingLeaf root_leaf;
+	root_leaf.leaf = 0;
+	root_leaf.start = 0;
+	root_leaf.end = workspace->rows.size();
+	root_leaf.features = features;
+	root_leaf.depth = 0;
+	if (evaluateLeaf(root_leaf)) queue.push_back(move(root_leaf));
+
+	while (!queue.empty()) {
+		pop_heap(queue.begin(), queue.end());
+		pendingLeaf best = move(queue.back());
+		queue.pop_back();
+
+		// split the rows first to know how many children the expansion would add, the leaf's
+		// rows may be reordered even if it is not expanded
+		size_t bounds_base = workspace->child_bounds.size();
+		int num_children = partitionRows(best.start, best.end, best.split_var, best.threshold, best.category_mask);
+		size_t child_bytes = num_children * sizeof(node);
+		if ((max_leaves >= 0 && num_leaves + num_children - 1 > max_leaves) || (max_bytes > 0 && num_bytes + child_bytes > max_bytes)) {
+			workspace->child_bounds.resize(bounds_base);
+			workspace->seen_codes.clear();
+			continue;
+		}
+		num_leaves += num_children - 1;
+		num_bytes += child_bytes;
+
+		addChildren(best.leaf, best.split_var, best.threshold, best.category_mask, bounds_base, num_children);
+		if (isMultiwayFeature(best.split_var)) best.features.erase(find(best.features.begin(), best.features.end(), best.split_var));
+		int first_child = nodes[best.leaf].first_child;
+		for (int x = 0; x < num_children; x++) {
+			pendingLeaf child_leaf;
+			child_leaf.leaf = first_child + x;
+			child_leaf.start = workspace->child_bounds[bounds_base + x];
+			child_leaf.end = workspace->child_bounds[bounds_base + x + 1];
+			child_leaf.features = best.features;
+			child_leaf.depth = best.depth + 1;
+			if (evaluateLeaf(child_leaf)) {
+				queue.push_back(move(child_leaf));
+				push_heap(queue.begin(), queue.end());
+			}
+		}
+		workspace->child_bounds.resize(bounds_base);
+	}
+}
+
+/*
+* Turns the pending leaf's node into a leaf with its majority (or mean) label, then finds its 
+* best split the same way buildTree does.
+*
+* Returns: - [bool] whether or not the leaf can be expanded further
+*/
+bool decisionTree::evaluateLeaf(pendingLeaf& pending)
+{
+	auto split_info = findNodeSplit(pending.start, pending.end, pending.features, pending.leaf, pending.depth);
+	pending.split_var = get<0>(split_info);
+	pending.threshold = get<1>(split_info);
+	pending.category_mask = workspace->split_mask;
+	pending.priority = get<2>(split_info) * nodes[pending.leaf].frequency;
+
+	return pending.split_var != -1;
+}
+
+/*
+* Makes node_idx a leaf with the label and training error of the rows in [start, end), then
+* checks whether it should be split further and, if so, finds the best split. If the tree is
+* part of a forest, the split is chosen on a random subset of the rows (on all of them, among 
+* random splits, for extremely randomized trees).
+*
+* Returns: - [tuple<int,double,double>] the (original) position of the split variable, -1 if the
+*            node stays a leaf, its threshold (continuous data only) and the gain of the split
+*/
+tuple<int,double,double> decisionTree::findNodeSplit(size_t start, size_t end, vector<int>& features, int node_idx, int depth)
+{
+	tuple<int,double,double> no_split = make_tuple(-1, -1, 0);
+
 	// if there is no input data, something went wrong
-	if (input_data.empty()) {
+	if (start >= end) {
 		wcout << L"ERROR: empty data detected, please check for errors" << endl;
 		exit(-1);
 	}
-	
-    vvd bkp_data_info;
-    if (is_discrete) {
-        bkp_data_info = data_info;
-        data_info = getDatasetInfo(input_data);
-    }
-	map<double,int> bkp_labels = labels;
-	labels = getLabelInfo(input_data);
+
+	const int* rows = &workspace->rows[start];
+	size_t count = end - start;
+	vd& stats = workspace->node_stats;
+	getNodeStats(rows, count, stats);
+	node& node_ref = nodes[node_idx];
+	// every node remembers the label and training error it would have as a leaf, for pruning
+	node_ref.is_leaf = true;
+	node_ref.label = getCutoffLeafLabel(stats);
+	node_ref.error = getLeafError(rows, count, stats, node_ref.label);
 	// check if the tree is at a leaf
-	auto is_leaf = checkLeaf(input_data);
+	auto is_leaf = checkLeaf(rows, count, features, stats);
 	if (get<0>(is_leaf)) {
-		node_ref.is_leaf = true;
 		node_ref.label = get<1>(is_leaf);
-		if (is_discrete) data_info = bkp_data_info;
-		labels = bkp_labels;
-		return node_ref;
-	}
-    if (input_data.size() < (size_t)min_data_size) {
-        node_ref.is_leaf = true;
-        node_ref.label = getCutoffLeafLabel();
-        if (is_discrete) data_info = bkp_data_info;
-        labels = bkp_labels;
-        return node_ref;
-    }
-
-	// choose how to split based on if the tree is part of a forest 
-    // OR if the data is discrete or continuous
-	// for reference:
-	//   - discrete - split on all possible values for that variable
-	//   - continuous - find the best threshold for that variable and make a 
-	//                  binary split
-	// also, if the tree is part of a forest, split on a random subset of 
-	// the data
-	vvd split_data;
-    vvd ref_data_info;
-    map<double, int> ref_labels;
-	if (is_in_forest) {
-		int num_data = (int) ceil(sqrt(input_data.size()));
-		split_data = getForestNodeData(input_data, num_data);
-		// the following is necessary because of the references to data_info and 
-		// labels in bestSplitVar (and all reliant functions), this system can 
-		// almost certainly be improved and eventually maybe possibly will
-        if (is_discrete) {
-            ref_data_info = data_info;
-            data_info = getDatasetInfo(split_data);
-        }
-        ref_labels = labels;
-		labels = getLabelInfo(split_data);
+		return no_split;
+	}
+	int node_size = node_ref.frequency;
+	if (node_size < min_data_size || (max_depth >= 0 && depth >= max_depth)) return no_split;
+
+	tuple<int,double,double> split_info;
+	if (extra_trees) {
+		split_info = randomSplitVar(rows, count, features);
+	} else if (is_in_forest) {
+		getForestNodeData(start, end, (int) ceil(sqrt(node_size)));
+		workspace->weights = workspace->sample_weights.data();
+		split_info = bestSplitVar(workspace->sample_rows.data(), workspace->sample_rows.size(), features);
+		workspace->weights = workspace->row_weights.data();
+		for (size_t x = 0; x < workspace->sample_rows.size(); x++) {
+			workspace->sample_weights[workspace->sample_rows[x]] = 0;
+		}
 	} else {
-		split_data = input_data;
-	}
-    
-    auto split_info = bestSplitVar(split_data);
-    int split_var = get<0>(split_info);
-    if (is_in_forest) {
-        if (is_discrete) data_info = ref_data_info;
-        labels = ref_labels;
-    }
-	if (is_discrete) {
+		split_info = bestSplitVar(rows, count, features);
+	}
+	int split_var = get<0>(split_info);
+	double split_threshold = get<1>(split_info);
+	if (is_discrete && is_multiway) {
 		if (split_var == -1) {
 			wcout << L"ERROR: no split variable detected, please check for errors" << endl;
 			exit(-1);
 		}
-		node_ref.split_var = indices[split_var];
-		for (size_t x = 0; x < data_info[split_var].size(); x++) {
-			node child;
-			child.split_var = indices[split_var];
-			child.split_val = data_info[split_var][x];
-			child.is_leaf = false;
-			vvd data_subset = subsetDiscreteData(input_data, split_var, data_info[split_var][x]);
-			child.frequency = data_subset.size();
-			vector<int> subset_indices = indices;
-			subset_indices.erase(subset_indices.begin() + split_var);
-			node_ref.children.push_back(buildTree(data_subset, subset_indices, child));
-		}
-		data_info = bkp_data_info;
-		labels = bkp_labels;
-		return node_ref;
+		return split_info;
+	}
+
+	// check for and handle rare exact-same data case (for partition splits, a forest node whose 
+	// sampled rows have a single value for every feature)
+	if ((-1 == split_var) && (is_discrete || -1 == split_threshold)) {
+		if (is_classification) node_ref.label = (*train_data)[rows[0]].back();
+		node_ref.error = getLeafError(rows, count, stats, node_ref.label);
+		return no_split;
 	} else {
-		double split_threshold = get<1>(split_info);
-        // check for and handle rare exact-same data case
-        if ((-1 == split_var) && (-1 == split_threshold)) {
-            node_ref.is_leaf = true;
-            node_ref.label = input_data[0][input_data[0].size() - 1];
-            labels = bkp_labels;
-            return node_ref;
-        } else {
-            if (split_var == -1) {
-                wcout << L"ERROR: no split variable detected, please check for errors" << endl;
-                exit(-1);
-            }
-            if (split_threshold == -1) {
-                wcout << L"ERROR: no split threshold detected in continuous mode, please check for errors" << endl;
-                exit(-1);
-            }
-        }
-		node_ref.split_var = indices[split_var];
-		node_ref.threshold = split_threshold;
-		node left_child;
-		left_child.split_var = indices[split_var];
-		left_child.is_leaf = false;
-		node right_child;
-		right_child.split_var = indices[split_var];
-		right_child.is_leaf = false;
-		vector<vvd> data_subsets = subsetContinuousData(input_data, split_var, split_threshold);
-		left_child.frequency = data_subsets[0].size();
-		right_child.frequency = data_subsets[1].size();
-		node_ref.children.push_back(buildTree(data_subsets[0], indices, left_child));
-		node_ref.children.push_back(buildTree(data_subsets[1], indices, right_child));
-		labels = bkp_labels;
-		return node_ref;
-	}
-}
-
-vvd decisionTree::getDatasetInfo(vvd& input_data)
-{
-	vvd data_info;
-
-	for (size_t y = 0; y < input_data[0].size() - 1; y++) {
-		vd var_info;
-		for (size_t x = 0; x < input_data.size(); x++) {
-			double val = input_data[x][y];
-			if (find(var_info.begin(), var_info.end(), val) == var_info.end()) {
-				var_info.push_back(val);
+		// NOTE: a continuous split always comes with its threshold, which can be -1 like any other 
+		//       value (e.g. between the -9 missing values of the raw data and 7)
+		if (split_var == -1) {
+			wcout << L"ERROR: no split variable detected, please check for errors" << endl;
+			exit(-1);
+		}
+	}
+
+	return split_info;
+}
+
+/*
+* Stably reorders the rows in [start, end) of the workspace so that the rows of each child of
+* the split are contiguous (in order of first appearance of the discrete values with multiway 
+* splits, in then out of category_mask with partition splits, or below then above the threshold), 
+* and pushes the bounds of the children onto child_bounds.
+*
+* Returns: - [int] the number of children of the split
+*/
+int decisionTree::partitionRows(size_t start, size_t end, int split_var, double threshold, uint64_t category_mask)
+{
+	treeWorkspace& ws = *workspace;
+	int* rows = &ws.rows[start];
+	int* buffer = ws.row_buffer.data();
+	size_t count = end - start;
+	ws.child_bounds.push_back(start);
+
+	if (!isMultiwayFeature(split_var)) {
+		size_t left_size = 0;
+		size_t right_size = 0;
+		for (size_t x = 0; x < count; x++) {
+			bool is_left = is_discrete ? ((category_mask >> ws.row_codes[split_var][rows[x]]) & 1) != 0 : (*train_data)[rows[x]][split_var] < threshold;
+			if (is_left) {
+				rows[left_size++] = rows[x];
+			} else {
+				buffer[right_size++] = rows[x];
+			}
+		}
+		copy(buffer, buffer + right_size, rows + left_size);
+		ws.child_bounds.push_back(start + left_size);
+		ws.child_bounds.push_back(end);
+		return 2;
+	}
+
+	// counting sort on the position of each row's value among the values seen in the node
+	ws.code_cursors.clear();
+	for (size_t x = 0; x < count; x++) {
+		size_t group = getGroup(rows[x], split_var, -1);
+		if (group == ws.code_cursors.size()) ws.code_cursors.push_back(0);
+		ws.code_cursors[group]++;
+	}
+	size_t offset = 0;
+	for (size_t g = 0; g < ws.code_cursors.size(); g++) {
+		size_t group_size = ws.code_cursors[g];
+		ws.code_cursors[g] = offset;
+		offset += group_size;
+		ws.child_bounds.push_back(start + offset);
+	}
+	for (size_t x = 0; x < count; x++) {
+		buffer[ws.code_cursors[getGroup(rows[x], split_var, -1)]++] = rows[x];
+	}
+	copy(buffer, buffer + count, rows);
+	int num_children = ws.seen_codes.size();
+	// NOTE: seen_codes is kept until addChildren has read the children's split values
+	for (size_t g = 0; g < ws.seen_codes.size(); g++) {
+		ws.code_positions[ws.seen_codes[g]] = -1;
+	}
+
+	return num_children;
+}
+
+/*
+* Returns: - [int] the group of the row for the feature at idx: the position of its value among
+*            the values seen so far (discrete data), or which side of the threshold it is on
+*/
+int decisionTree::getGroup(int row, int idx, double threshold)
+{
+	if (!is_discrete) return ((*train_data)[row][idx] < threshold) ? 0 : 1;
+
+	int code = workspace->row_codes[idx][row];
+	int& position = workspace->code_positions[code];
+	if (position == -1) {
+		position = workspace->seen_codes.size();
+		workspace->seen_codes.push_back(code);
+	}
+
+	return position;
+}
+
+void decisionTree::resetGroups()
+{
+	for (size_t g = 0; g < workspace->seen_codes.size(); g++) {
+		workspace->code_positions[workspace->seen_codes[g]] = -1;
+	}
+	workspace->seen_codes.clear();
+}
+
+/*
+* Turns node_idx into an internal node and appends its children (whose row ranges start at
+* child_bounds[bounds_base]) to the end of the node pool. With partition splits the first child
+* gets the categories of category_mask and the second child all the others.
+*/
+void decisionTree::addChildren(int node_idx, int split_var, double threshold, uint64_t category_mask, size_t bounds_base, int num_children)
+{
+	node& node_ref = nodes[node_idx];
+	node_ref.is_leaf = false;
+	node_ref.split_var = split_var;
+	if (!is_discrete) node_ref.threshold = threshold;
+	node_ref.first_child = nodes.size();
+	node_ref.num_children = num_children;
+
+	for (int x = 0; x < num_children; x++) {
+		node child;
+		child.split_var = split_var;
+		if (isMultiwayFeature(split_var)) {
+			child.split_val = workspace->categories[split_var][workspace->seen_codes[x]];
+		} else if (is_discrete) {
+			child.category_mask = (x == 0) ? category_mask : getFeatureMask(split_var) & ~category_mask;
+		}
+		child.frequency = 0;
+		for (size_t i = workspace->child_bounds[bounds_base + x]; i < workspace->child_bounds[bounds_base + x + 1]; i++) {
+			child.frequency += workspace->row_weights[workspace->rows[i]];
+		}
+		nodes.push_back(child);
+	}
+	if (isMultiwayFeature(split_var)) workspace->seen_codes.clear();
+}
+
+/*
+* Returns: - [uint64_t] the mask with the bits of all the categories of the feature at idx set
+*/
+uint64_t decisionTree::getFeatureMask(int idx)
+{
+	size_t num_categories = categories[idx].size();
+	if (num_categories >= 64) return ~(uint64_t) 0;
+
+	return ((uint64_t) 1 << num_categories) - 1;
+}
+
+/*
+* Returns: - [bool] whether the discrete feature at idx is split with one child per value, either 
+*            because the tree uses multiway splits or because the feature has too many values 
+*            for the category masks (its list of values is then left empty)
+*/
+bool decisionTree::isMultiwayFeature(int idx)
+{
+	return is_discrete && (is_multiway || categories[idx].empty());
+}
+
+void decisionTree::buildSparseTree(sparseContext& context, size_t start, size_t end, int node_idx, int depth)
+{
+	// label counts (classification) or count, sum and squared sum (regression) of the node
+	vd& stats = context.node_stats;
+	stats.assign(is_classification ? context.class_values.size() : 3, 0);
+	for (size_t x = start; x < end; x++) {
+		addSparseStats(context, stats, context.rows[x], 1);
+	}
+	size_t count = end - start;
+	node& node_ref = nodes[node_idx];
+	if (is_classification) {
+		ptrdiff_t best_class = distance(stats.begin(), max_element(stats.begin(), stats.end()));
+		node_ref.label = context.class_values[best_class];
+		node_ref.error = count - stats[best_class];
+	} else {
+		node_ref.label = stats[1] / stats[0];
+		node_ref.error = max(0.0, stats[2] - stats[1] * stats[1] / stats[0]);
+	}
+
+	node_ref.is_leaf = true;
+	if (count == 1 || node_ref.error < 1e-12) return;
+	if (count < (size_t) min_data_size || (max_depth >= 0 && depth >= max_depth)) return;
+	auto split_info = bestSparseSplit(context, start, end, stats);
+	int split_var = get<0>(split_info);
+	double split_threshold = get<1>(split_info);
+	if (split_var == -1) return;
+
+	size_t left_size = 0;
+	size_t right_size = 0;
+	for (size_t x = start; x < end; x++) {
+		int row = context.rows[x];
+		if (getSparseValue(*context.data, row, split_var) < split_threshold) {
+			context.rows[start + left_size++] = row;
+		} else {
+			context.row_buffer[right_size++] = row;
+		}
+	}
+	copy(context.row_buffer.begin(), context.row_buffer.begin() + right_size, context.rows.begin() + start + left_size);
+
+	int first_child = nodes.size();
+	node_ref.is_leaf = false;
+	node_ref.split_var = split_var;
+	node_ref.threshold = split_threshold;
+	node_ref.first_child = first_child;
+	node_ref.num_children = 2;
+	size_t bounds[] = { start, start + left_size, end };
+	for (int x = 0; x < 2; x++) {
+		node child;
+		child.split_var = split_var;
+		child.frequency = bounds[x + 1] - bounds[x];
+		nodes.push_back(child);
+	}
+	for (int x = 0; x < 2; x++) {
+		buildSparseTree(context, bounds[x], bounds[x + 1], first_child + x, depth + 1);
+	}
+}
+
+/*
+* Finds the best threshold split of the node's rows. The non-zero entries of the node's rows are 
+* bucketed by column with a counting pass over their CSR rows, and only the columns that got 
+* entries are searched (ties go to the lowest column, as if the columns were searched in order). Within a column the 
+* entries are sorted, the zero entries form one more group whose stats are the node's stats 
+* minus those of the non-zero entries. The thresholds are the 
+* midpoints between consecutive distinct values (zero included), as in getThresholds.
+*
+* Returns: - [tuple<int,double,double>] the best split column (-1 if there is none), its threshold 
+*            and the information gain (or variance reduction) of the split
+*/
+tuple<int,double,double> decisionTree::bestSparseSplit(sparseContext& context, size_t start, size_t end, vd& node_stats)
+{
+	int best_split_var = -1;
+	double best_threshold = -1;
+	double max_info_gain = -numeric_limits<double>::infinity();
+	csrMatrix& data = *context.data;
+	double base_impurity = getImpurity(node_stats);
+	size_t count = end - start;
+	double node_size = count;
+
+	// count the node's non-zeros per column, then turn the counts into bucket offsets
+	vector<size_t>& col_counts = context.col_counts;
+	vector<int>& node_cols = context.node_cols;
+	node_cols.clear();
+	size_t node_nonzeros = 0;
+	for (size_t x = start; x < end; x++) {
+		int row = context.rows[x];
+		for (size_t k = data.row_ptr[row]; k < data.row_ptr[row + 1]; k++) {
+			if (col_counts[data.col_idx[k]]++ == 0) node_cols.push_back(data.col_idx[k]);
+		}
+		node_nonzeros += data.row_ptr[row + 1] - data.row_ptr[row];
+	}
+	size_t offset = 0;
+	for (size_t c = 0; c < node_cols.size(); c++) {
+		size_t col_count = col_counts[node_cols[c]];
+		col_counts[node_cols[c]] = offset;
+		offset += col_count;
+	}
+	// after the fill every column's counter points at the end of its bucket
+	vector<pair<double,int>>& node_entries = context.entries;
+	node_entries.resize(node_nonzeros);
+	for (size_t x = start; x < end; x++) {
+		int row = context.rows[x];
+		for (size_t k = data.row_ptr[row]; k < data.row_ptr[row + 1]; k++) {
+			node_entries[col_counts[data.col_idx[k]]++] = make_pair(data.values[k], row);
+		}
+	}
+
+	vd& nonzero_stats = context.nonzero_stats;
+	vd& left_stats = context.left_stats;
+	vd& right_stats = context.right_stats;
+	nonzero_stats.resize(node_stats.size());
+	left_stats.resize(node_stats.size());
+	right_stats.resize(node_stats.size());
+	size_t col_start = 0;
+	for (size_t c = 0; c < node_cols.size(); c++) {
+		int y = node_cols[c];
+		vector<pair<double,int>>::iterator entries = node_entries.begin() + col_start;
+		size_t num_entries = col_counts[y] - col_start;
+		col_start = col_counts[y];
+		col_counts[y] = 0;
+		sort(entries, entries + num_entries);
+
+		fill(nonzero_stats.begin(), nonzero_stats.end(), 0);
+		for (size_t k = 0; k < num_entries; k++) {
+			addSparseStats(context, nonzero_stats, entries[k].second, 1);
+		}
+		bool zero_pending = num_entries < count;
+		fill(left_stats.begin(), left_stats.end(), 0);
+		double left_size = 0;
+		double prev_val = 0;
+		bool has_prev = false;
+		size_t k = 0;
+		while (k < num_entries || zero_pending) {
+			bool is_zero = zero_pending && (k == num_entries || entries[k].first > 0);
+			double val = is_zero ? 0 : entries[k].first;
+			if (has_prev) {
+				for (size_t s = 0; s < right_stats.size(); s++) {
+					right_stats[s] = node_stats[s] - left_stats[s];
+				}
+				double entropy = (left_size / node_size) * getImpurity(left_stats) 
+					+ ((node_size - left_size) / node_size) * getImpurity(right_stats);
+				double info_gain = base_impurity - entropy;
+				if (info_gain > max_info_gain || (info_gain == max_info_gain && y < best_split_var)) {
+					best_split_var = y;
+					best_threshold = (prev_val + val) / (double) 2;
+					max_info_gain = info_gain;
+				}
+			}
+			if (is_zero) {
+				for (size_t s = 0; s < left_stats.size(); s++) {
+					left_stats[s] += node_stats[s] - nonzero_stats[s];
+				}
+				left_size += count - num_entries;
+				zero_pending = false;
+			} else {
+				for (; k < num_entries && entries[k].first == val; k++) {
+					addSparseStats(context, left_stats, entries[k].second, 1);
+					left_size++;
+				}
+			}
+			prev_val = val;
+			has_prev = true;
+		}
+	}
+
+	return make_tuple(best_split_var, best_threshold, max_info_gain);
+}
+
+void decisionTree::addSparseStats(sparseContext& context, vd& stats, int row, double weight)
+{
+	if (is_classification) {
+		stats[context.row_classes[row]] += weight;
+	} else {
+		double label = context.labels[row];
+		stats[0] += weight;
+		stats[1] += weight * label;
+		stats[2] += weight * label * label;
+	}
+}
+
+/*
+* Returns: - [double] the entropy of the label counts, or the variance of the labels for regression 
+*            (stats holds their count, sum and squared sum)
+*/
+double decisionTree::getImpurity(vd& stats)
+{
+	if (!is_classification) {
+		if (stats[0] <= 0) return 0;
+		return max(0.0, (stats[2] - stats[1] * stats[1] / stats[0]) / stats[0]);
+	}
+
+	double total = 0;
+	for (size_t s = 0; s < stats.size(); s++) {
+		total += stats[s];
+	}
+	double entropy = 0;
+	for (size_t s = 0; s < stats.size(); s++) {
+		if (stats[s] > 0) {
+			double prob = stats[s] / total;
+			entropy -= prob * log2(prob);
+		}
+	}
+
+	return entropy;
+}
+
+/*
+* Fills stats with the label counts (classification) or the count, sum and squared sum of the
+* labels (regression) of the given rows, each counted as many times as its weight.
+*/
+void decisionTree::getNodeStats(const int* rows, size_t count, vd& stats)
+{
+	const int* weights = workspace->weights;
+	if (is_classification) {
+		stats.assign(workspace->class_values.size(), 0);
+		for (size_t x = 0; x < count; x++) {
+			stats[workspace->row_classes[rows[x]]] += weights[rows[x]];
+		}
+		return;
+	}
+
+	stats.assign(3, 0);
+	for (size_t x = 0; x < count; x++) {
+		double label = (*train_data)[rows[x]].back();
+		double weight = weights[rows[x]];
+		stats[0] += weight;
+		stats[1] += weight * label;
+		stats[2] += weight * label * label;
+	}
+}
+
+/*
+* This function checks two things in order to determine if the node is a leaf:
+*  1. if all of the remaining data has the same label
+*  2. if all of the remaining data has the same values for every feature
+*/
+tuple<bool,double> decisionTree::checkLeaf(const int* rows, size_t count, vector<int>& features, vd& stats)
+{
+	vvd& input_data = *train_data;
+	double first_label = input_data[rows[0]].back();
+	if (count == 1) return make_tuple(true, first_label);
+
+	bool same_labels = true;
+	if (is_classification) {
+		same_labels = stats[workspace->row_classes[rows[0]]] == accumulate(stats.begin(), stats.end(), 0.0);
+	} else {
+		for (size_t x = 1; x < count && same_labels; x++) {
+			same_labels = input_data[rows[x]].back() == first_label;
+		}
+	}
+	if (same_labels) {
+		return make_tuple(true, first_label);
+	} else {
+		for (size_t y = 0; y < features.size(); y++) {
+			double sample_var_val = input_data[rows[0]][features[y]];
+			for (size_t x = 1; x < count; x++) {
+				double test_var_val = input_data[rows[x]][features[y]];
+				if (test_var_val != sample_var_val) return make_tuple(false, -1);
 			}
 		}
-		data_info.push_back(var_info);
+
+		return make_tuple(true, getCutoffLeafLabel(stats));
+	}
+}
+
+/*
+* Returns: - [tuple<int,double,double>] the (original) position of the best split variable, its
+*            threshold (continuous data only) and the information gain (or variance reduction)
+*            of the split, with partition splits the workspace's split_mask holds its categories
+*/
+tuple<int,double,double> decisionTree::bestSplitVar(const int* rows, size_t count, vector<int>& features)
+{
+	int best_split_var = -1;
+	double best_threshold = -1;
+
+	// H(Y), or Var(Y) for regression
+	double label_entropy = is_classification ? calculateEntropy(rows, count, -1, -1) : calculateVariance(rows, count, -1, -1);
+
+	double max_info_gain = -numeric_limits<double>::infinity();
+	workspace->split_mask = 0;
+	if (is_discrete) {
+		for (size_t y = 0; y < features.size(); y++) {
+			uint64_t category_mask = 0;
+			double var_info_gain;
+			if (isMultiwayFeature(features[y])) {
+				var_info_gain = calculateInfoGain(rows, count, features[y], -1, label_entropy);
+			} else {
+				var_info_gain = bestCategoryPartition(rows, count, features[y], label_entropy, category_mask);
+			}
+			if (var_info_gain > max_info_gain) {
+				best_split_var = features[y];
+				max_info_gain = var_info_gain;
+				workspace->split_mask = category_mask;
+			}
+		}
+	} else {
+		vd& thresholds = workspace->thresholds;
+		for (size_t y = 0; y < features.size(); y++) {
+			getThresholds(rows, count, features[y]);
+			for (size_t x = 0; x < thresholds.size(); x++) {
+				double var_info_gain = calculateInfoGain(rows, count, features[y], thresholds[x], label_entropy);
+				if (var_info_gain > max_info_gain) {
+					best_split_var = features[y];
+					best_threshold = thresholds[x];
+					max_info_gain = var_info_gain;
+				}
+			}
+		}
+	}
+
+	return make_tuple(best_split_var, best_threshold, max_info_gain);
+}
+
+/*
+* Extremely randomized trees (ExtraTrees) counterpart of bestSplitVar: instead of scanning every
+* threshold of every feature, ceil(sqrt(number of features)) features that are not constant over
+* the rows are drawn at random, each gets one threshold drawn uniformly between its minimum and
+* maximum, and the best of these splits is kept. There is no sort and no threshold scan, so a
+* node costs O(rows x drawn features). For discrete data only the features are drawn at random,
+* and the best split of each is searched as usual.
+*
+* Returns: - [tuple<int,double,double>] the same as bestSplitVar
+*/
+tuple<int,double,double> decisionTree::randomSplitVar(const int* rows, size_t count, vector<int>& features)
+{
+	treeWorkspace& ws = *workspace;
+	vvd& input_data = *train_data;
+	int best_split_var = -1;
+	double best_threshold = -1;
+	double max_info_gain = -numeric_limits<double>::infinity();
+	double label_entropy = 0;
+	if (!is_discrete) label_entropy = is_classification ? calculateEntropy(rows, count, -1, -1) : calculateVariance(rows, count, -1, -1);
+
+	size_t num_draws = (size_t) ceil(sqrt(features.size()));
+	vector<int>& candidates = ws.candidate_features;
+	candidates.assign(features.begin(), features.end());
+	ws.drawn_features.clear();
+	for (size_t x = 0; x < candidates.size() && ws.drawn_features.size() < num_draws; x++) {
+		// partial Fisher-Yates shuffle, so the features are drawn without replacement
+		swap(candidates[x], candidates[x + rng() % (candidates.size() - x)]);
+		int idx = candidates[x];
+		double min_val = input_data[rows[0]][idx];
+		double max_val = input_data[rows[0]][idx];
+		for (size_t i = 1; i < count; i++) {
+			min_val = min(min_val, input_data[rows[i]][idx]);
+			max_val = max(max_val, input_data[rows[i]][idx]);
+		}
+		if (min_val == max_val) continue;
+		ws.drawn_features.push_back(idx);
+		if (is_discrete) continue;
+
+		// draw from (0, 1) so that both sides of the threshold get rows
+		double fraction = (rng() - rng.min() + 1) / (double) (rng.max() - rng.min() + 2);
+		double threshold = min_val + fraction * (max_val - min_val);
+		if (!(threshold > min_val)) threshold = max_val;
+		double var_info_gain = calculateInfoGain(rows, count, idx, threshold, label_entropy);
+		if (var_info_gain > max_info_gain) {
+			best_split_var = idx;
+			best_threshold = threshold;
+			max_info_gain = var_info_gain;
+		}
+	}
+	if (is_discrete) return bestSplitVar(rows, count, ws.drawn_features);
+
+	return make_tuple(best_split_var, best_threshold, max_info_gain);
+}
+
+/*
+* Entropy of the labels of the given rows if idx is -1, otherwise the conditional entropy of the
+* labels given the feature at idx (its discrete values, or the sides of the threshold).
+*
+* NOTE: future improvements could include restructuring the procedure to use a general (i.e. base) 
+*       case entropy calculation function then have other calculations (e.g. conditional entropy) 
+*       call that base case function
+*/
+double decisionTree::calculateEntropy(const int* rows, size_t count, int idx, double threshold)
+{
+	double entropy = 0;
+	treeWorkspace& ws = *workspace;
+	size_t num_classes = ws.class_values.size();
+	// the number of rows, adding up their weights
+	double total = 0;
+
+	if (idx == -1) {
+		vd& label_counts = ws.group_stats;
+		label_counts.assign(num_classes, 0);
+		for (size_t x = 0; x < count; x++) {
+			label_counts[ws.row_classes[rows[x]]] += ws.weights[rows[x]];
+			total += ws.weights[rows[x]];
+		}
+		for (size_t lbl = 0; lbl < num_classes; lbl++) {
+			double prob = label_counts[lbl] / total;
+			double label_entropy = 0;
+			if (prob != 0) {
+				label_entropy = -prob * log2(prob);
+			}
+			entropy += label_entropy;
+		}
+	} else {
+		// some helpful information regarding the variables var_val_counts and var_label_counts:
+		//   - var_val_counts:
+		//     Tracks the number of occurrences of every group of the feature at idx, i.e. every
+		//     discrete value (in order of first appearance in the rows) or each side of the
+		//     threshold for continuous data.
+		//
+		//   - var_label_counts:
+		//     Tracks the number of occurrences of each label per group, stored row by row (one
+		//     row of num_classes counts per group). So, for example, the feature at idx could
+		//     have the following possible values with the following frequencies of labels:
+		//       - 0 -> label 1: 3
+		//           -> label 2: 0
+		//           -> label 3: 1
+		//       - 3 -> label 1: 1
+		//           -> label 2: 0
+		//           -> label 3: 0
+		size_t max_groups = is_discrete ? ws.categories[idx].size() : 2;
+		vd& var_val_counts = ws.group_counts;
+		vd& var_label_counts = ws.group_stats;
+		var_val_counts.assign(max_groups, 0);
+		var_label_counts.assign(max_groups * num_classes, 0);
+		for (size_t x = 0; x < count; x++) {
+			int val_pos = getGroup(rows[x], idx, threshold);
+			double weight = ws.weights[rows[x]];
+			var_val_counts[val_pos] += weight;
+			var_label_counts[val_pos * num_classes + ws.row_classes[rows[x]]] += weight;
+			total += weight;
+		}
+		size_t num_groups = is_discrete ? ws.seen_codes.size() : 2;
+		if (is_discrete) resetGroups();
+		// H(Y|X)
+		for (size_t y = 0; y < num_groups; y++) {
+			// P(X = x_j)
+			double var_prob = var_val_counts[y] / total;
+			// calculating conditional entropy
+			double cond_entropy = 0;
+			for (size_t lbl = 0; lbl < num_classes; lbl++) {
+				// P(Y = y_i | X = x_j)
+				double label_prob = 0;
+				if (var_val_counts[y] != 0) {
+					label_prob = var_label_counts[y * num_classes + lbl] / var_val_counts[y];
+				}
+				double label_entropy = 0;
+				if (label_prob != 0) {
+					label_entropy = label_prob * log2(label_prob);
+				}
+				cond_entropy += label_entropy;
+			}
+			double var_entropy = -var_prob * cond_entropy;
+			entropy += var_entropy;
+		}
+	}
+
+	return entropy;
+}
+
+/*
+* Regression counterpart of calculateEntropy, the "gain" of a split is then the reduction in 
+* label variance. For idx -1 this is Var(Y), otherwise it is the within-group variance of the
+* labels weighted by the size of each group (one group per discrete value, or the two sides of
+* the threshold for continuous data).
+*/
+double decisionTree::calculateVariance(const int* rows, size_t count, int idx, double threshold)
+{
+	treeWorkspace& ws = *workspace;
+	size_t max_groups = 1;
+	if (idx != -1) max_groups = is_discrete ? ws.categories[idx].size() : 2;
+
+	// count, sum and squared sum of the labels of each group
+	vd& group_stats = ws.group_stats;
+	group_stats.assign(3 * max_groups, 0);
+	double total = 0;
+	for (size_t x = 0; x < count; x++) {
+		size_t group = (idx == -1) ? 0 : getGroup(rows[x], idx, threshold);
+		double label = (*train_data)[rows[x]].back();
+		double weight = ws.weights[rows[x]];
+		group_stats[3 * group] += weight;
+		group_stats[3 * group + 1] += weight * label;
+		group_stats[3 * group + 2] += weight * label * label;
+		total += weight;
+	}
+	size_t num_groups = max_groups;
+	if (idx != -1 && is_discrete) {
+		num_groups = ws.seen_codes.size();
+		resetGroups();
+	}
+
+	double variance = 0;
+	for (size_t g = 0; g < num_groups; g++) {
+		double group_count = group_stats[3 * g];
+		if (group_count != 0) {
+			variance += group_stats[3 * g + 2] - group_stats[3 * g + 1] * group_stats[3 * g + 1] / group_count;
+		}
+	}
+
+	return max(0.0, variance / total);
+}
+
+double decisionTree::calculateInfoGain(const int* rows, size_t count, int idx, double threshold, double base_entropy)
+{
+	double info_gain = 0;
+
+	double entropy = is_classification ? calculateEntropy(rows, count, idx, threshold) : calculateVariance(rows, count, idx, threshold);
+	info_gain = base_entropy - entropy;
+
+	return info_gain;
+}
+
+/*
+* Finds the best split of the discrete values of the feature at idx into two groups. The values 
+* seen in the rows are ordered by the proportion of the rows' most frequent label among their 
+* rows (by their mean label for regression), and only the splits between consecutive values of 
+* that order are evaluated. For two labels and for regression this order is known to contain the 
+* best of all the partitions (Breiman et al.), for more labels it is a heuristic. Values that do 
+* not appear in the rows go with the larger group.
+*
+* Returns: - [double] the information gain (or variance reduction) of the best partition, -infinity 
+*            if the rows all have the same value, category_mask is set to the first group
+*/
+double decisionTree::bestCategoryPartition(const int* rows, size_t count, int idx, double base_entropy, uint64_t& category_mask)
+{
+	treeWorkspace& ws = *workspace;
+	size_t stat_size = is_classification ? ws.class_values.size() : 3;
+	size_t max_groups = ws.categories[idx].size();
+
+	// label counts (or count, sum and squared sum) of each value, in order of first appearance
+	vd& group_counts = ws.group_counts;
+	vd& group_stats = ws.group_stats;
+	group_counts.assign(max_groups, 0);
+	group_stats.assign(max_groups * stat_size, 0);
+	double node_size = 0;
+	for (size_t x = 0; x < count; x++) {
+		size_t group = getGroup(rows[x], idx, -1);
+		double weight = ws.weights[rows[x]];
+		group_counts[group] += weight;
+		node_size += weight;
+		if (is_classification) {
+			group_stats[group * stat_size + ws.row_classes[rows[x]]] += weight;
+		} else {
+			double label = (*train_data)[rows[x]].back();
+			group_stats[group * stat_size] += weight;
+			group_stats[group * stat_size + 1] += weight * label;
+			group_stats[group * stat_size + 2] += weight * label * label;
+		}
+	}
+	size_t num_groups = ws.seen_codes.size();
+	if (num_groups < 2) {
+		resetGroups();
+		return -numeric_limits<double>::infinity();
+	}
+
+	vd& total_stats = ws.total_stats;
+	total_stats.assign(stat_size, 0);
+	for (size_t g = 0; g < num_groups; g++) {
+		for (size_t s = 0; s < stat_size; s++) {
+			total_stats[s] += group_stats[g * stat_size + s];
+		}
+	}
+	size_t order_label = is_classification ? distance(total_stats.begin(), max_element(total_stats.begin(), total_stats.end())) : 1;
+	vd& group_keys = ws.group_keys;
+	vector<int>& group_order = ws.group_order;
+	group_keys.resize(num_groups);
+	group_order.resize(num_groups);
+	for (size_t g = 0; g < num_groups; g++) {
+		group_keys[g] = group_stats[g * stat_size + order_label] / group_counts[g];
+		group_order[g] = g;
+	}
+	stable_sort(group_order.begin(), group_order.end(), [&group_keys](int a, int b) { return group_keys[a] < group_keys[b]; });
+
+	vd& left_stats = ws.left_stats;
+	vd& right_stats = ws.right_stats;
+	left_stats.assign(stat_size, 0);
+	right_stats.resize(stat_size);
+	double left_size = 0;
+	double best_left_size = 0;
+	size_t best_groups = 0;
+	double max_info_gain = -numeric_limits<double>::infinity();
+	for (size_t g = 0; g + 1 < num_groups; g++) {
+		int group = group_order[g];
+		for (size_t s = 0; s < stat_size; s++) {
+			left_stats[s] += group_stats[group * stat_size + s];
+			right_stats[s] = total_stats[s] - left_stats[s];
+		}
+		left_size += group_counts[group];
+		double entropy = (left_size / node_size) * getImpurity(left_stats) 
+			+ ((node_size - left_size) / node_size) * getImpurity(right_stats);
+		double info_gain = base_entropy - entropy;
+		if (info_gain > max_info_gain) {
+			max_info_gain = info_gain;
+			best_left_size = left_size;
+			best_groups = g + 1;
+		}
+	}
+
+	uint64_t seen_mask = 0;
+	category_mask = 0;
+	for (size_t g = 0; g < num_groups; g++) {
+		uint64_t bit = (uint64_t) 1 << ws.seen_codes[group_order[g]];
+		seen_mask |= bit;
+		if (g < best_groups) category_mask |= bit;
+	}
+	if (best_left_size >= node_size - best_left_size) category_mask |= getFeatureMask(idx) & ~seen_mask;
+	resetGroups();
+
+	return max_info_gain;
+}
+
+/*
+* Fills the workspace's thresholds with the candidate split points of the feature at idx: the
+* midpoints between consecutive distinct values of the given rows, or the shared bins that fall
+* inside their range.
+*/
+void decisionTree::getThresholds(const int* rows, size_t count, int idx)
+{
+	vvd& input_data = *train_data;
+	vd& thresholds = workspace->thresholds;
+	thresholds.clear();
+
+	// with shared bins there is no need to sort the column, only the candidates that fall 
+	// strictly inside the range of the node's values can produce a split
+	if (binned_thresholds != nullptr) {
+		double min_val = input_data[rows[0]][idx];
+		double max_val = input_data[rows[0]][idx];
+		for (size_t i = 1; i < count; i++) {
+			min_val = min(min_val, input_data[rows[i]][idx]);
+			max_val = max(max_val, input_data[rows[i]][idx]);
+		}
+		const vd& bins = (*binned_thresholds)[idx];
+		vd::const_iterator first = upper_bound(bins.begin(), bins.end(), min_val);
+		vd::const_iterator last = upper_bound(first, bins.end(), max_val);
+		thresholds.assign(first, last);
+		return;
+	}
+
+	vd& candidates = workspace->values;
+	candidates.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		candidates[i] = input_data[rows[i]][idx];
+	}
+	sort(candidates.begin(), candidates.end());
+
+	double split = candidates[0];
+	for (size_t x = 1; x < candidates.size(); x++) {
+		double next_candidate = candidates[x];
+		if (next_candidate != split) {
+			double threshold = (next_candidate + split) / (double) 2;
+			thresholds.push_back(threshold);
+			split = next_candidate;
+		}
+	}
+}
+
+/*
+* Returns: - [int] the position (among the children of node_ref) of the child that the data point follows
+*/
+int decisionTree::selectChild(const node& node_ref, vd& data)
+{
+	if (is_discrete && !isMultiwayFeature(node_ref.split_var)) {
+		const vd& values = categories[node_ref.split_var];
+		double data_val = data[node_ref.split_var];
+		const node& first_child = nodes[node_ref.first_child];
+		for (size_t c = 0; c < values.size(); c++) {
+			if (values[c] == data_val) return ((first_child.category_mask >> c) & 1) ? 0 : 1;
+		}
+		// a value never seen in training goes to the child with the highest frequency
+		return (nodes[node_ref.first_child + 1].frequency > first_child.frequency) ? 1 : 0;
+	}
+	else if (is_discrete) {
+		double data_val = data[node_ref.split_var];
+		int child_idx = 0;
+		int max_freq = -1;
+		for (int x = 0; x < node_ref.num_children; x++) {
+			const node& child = nodes[node_ref.first_child + x];
+			if (child.split_val == data_val) return x;
+			int freq = child.frequency;
+			if (freq > max_freq) {
+				max_freq = freq;
+				child_idx = x;
+			}
+		}
+		// if the data contains a value never seen before, throw it into the node 
+		// with the highest frequency
+		return child_idx;
+	}
+	else {
+		if (data[node_ref.split_var] < node_ref.threshold) return 0;
+		return 1;
+	}
+}
+
+/*
+* Walks the subtree at node_idx, summing the training error and number of its leaves, and keeps
+* track of the internal node with the smallest cost-complexity link strength
+*   g(t) = (R(t) - R(T_t)) / (|leaves(T_t)| - 1)
+* where R is the training error as a fraction of the rows at the root.
+*/
+void decisionTree::findWeakestLink(int node_idx, int& weakest, double& min_strength, double& subtree_error, int& subtree_leaves)
+{
+	const node& node_ref = nodes[node_idx];
+	if (node_ref.is_leaf) {
+		subtree_error = node_ref.error;
+		subtree_leaves = 1;
+		return;
+	}
+
+	subtree_error = 0;
+	subtree_leaves = 0;
+	for (int x = 0; x < node_ref.num_children; x++) {
+		double child_error;
+		int child_leaves;
+		findWeakestLink(node_ref.first_child + x, weakest, min_strength, child_error, child_leaves);
+		subtree_error += child_error;
+		subtree_leaves += child_leaves;
 	}
 
-	return data_info;
+	double strength = (node_ref.error - subtree_error) / nodes[0].frequency / max(1, subtree_leaves - 1);
+	if (strength < min_strength) {
+		min_strength = strength;
+		weakest = node_idx;
+	}
 }
 
-map<double,int> decisionTree::getLabelInfo(vvd& input_data)
+/*
+* Collapses, bottom-up, every subtree whose cost R(T_t) + alpha * |leaves(T_t)| is not lower 
+* than the cost R(t) + alpha of the node as a leaf. This gives the smallest subtree minimizing 
+* the cost-complexity measure for alpha.
+*
+* Returns: - [double] the cost of the (pruned) subtree
+*/
+double decisionTree::pruneCostComplexity(int node_idx, double alpha)
 {
-	map<double,int> label_info;
+	double leaf_cost = nodes[node_idx].error / nodes[0].frequency + alpha;
+	if (nodes[node_idx].is_leaf) return leaf_cost;
 
-	for (size_t x = 0; x < input_data.size(); x++) {
-		double label = input_data[x][input_data[x].size() - 1];
-		if (label_info.count(label) == 0) {
-			label_info[label] = 1;
-		} else {
-			label_info[label]++;
-		}
+	double subtree_cost = 0;
+	for (int x = 0; x < nodes[node_idx].num_children; x++) {
+		subtree_cost += pruneCostComplexity(nodes[node_idx].first_child + x, alpha);
+	}
+	if (leaf_cost <= subtree_cost + 1e-12) {
+		collapseNode(node_idx);
+		return leaf_cost;
 	}
 
-	return label_info;
+	return subtree_cost;
 }
 
 /*
-* This function checks two things in order to determine if the node is a leaf:
-*  1. if all of the remaining data has the same label
-*  2. if all of the remaining data has the same values for every feature
+* Routes the validation rows (given by rows) down the subtree and collapses, bottom-up, every 
+* subtree that does not make fewer validation errors than the node would as a leaf.
+*
+* Returns: - [double] the validation error of the (pruned) subtree
 */
-tuple<bool,double> decisionTree::checkLeaf(vvd& input_data)
+double decisionTree::pruneReducedError(int node_idx, vvd& validation_data, vd& validation_labels, vector<int>& rows)
 {
-	if (input_data.size() == 1) return make_tuple(true, input_data[0][input_data[0].size() - 1]);
-
-	if (labels.size() == 1) {
-		return make_tuple(true, input_data[0][input_data[0].size() - 1]);
-	} else {
-		for (size_t y = 0; y < input_data[0].size() - 1; y++) {
-			double sample_var_val = input_data[0][y];
-			for (size_t x = 1; x < input_data.size(); x++) {
-				double test_var_val = input_data[x][y];
-				if (test_var_val != sample_var_val) return make_tuple(false, -1);
-			}
+	const node& node_ref = nodes[node_idx];
+	double leaf_error = 0;
+	for (size_t x = 0; x < rows.size(); x++) {
+		double diff = validation_labels[rows[x]] - node_ref.label;
+		if (is_classification) {
+			if (diff != 0) leaf_error++;
+		} else {
+			leaf_error += diff * diff;
 		}
+	}
+	if (node_ref.is_leaf) return leaf_error;
 
-		return make_tuple(true, getCutoffLeafLabel());
+	vector<vector<int>> child_rows(node_ref.num_children);
+	for (size_t x = 0; x < rows.size(); x++) {
+		child_rows[selectChild(node_ref, validation_data[rows[x]])].push_back(rows[x]);
+	}
+	double subtree_error = 0;
+	for (int x = 0; x < node_ref.num_children; x++) {
+		subtree_error += pruneReducedError(node_ref.first_child + x, validation_data, validation_labels, child_rows[x]);
+	}
+	if (leaf_error <= subtree_error) {
+		collapseNode(node_idx);
+		return leaf_error;
 	}
+
+	return subtree_error;
 }
 
-tuple<int,double> decisionTree::bestSplitVar(vvd& input_data)
+/*
+* Turns node_idx into a leaf, its descendants stay in the pool until compactNodes is called.
+*/
+void decisionTree::collapseNode(int node_idx)
 {
-	int best_split_var = -1;
-	double best_threshold = -1;
+	nodes[node_idx].is_leaf = true;
+	nodes[node_idx].first_child = -1;
+	nodes[node_idx].num_children = 0;
+}
 
-	double label_entropy = calculateEntropy(input_data, input_data[0].size() - 1, -1); // H(Y)
+/*
+* Rebuilds the node pool without the nodes cut off by pruning, keeping the children of every
+* node contiguous (the nodes come out in breadth-first order).
+*/
+void decisionTree::compactNodes()
+{
+	vector<node> compacted;
+	compacted.reserve(countNodes(0, false));
+	compacted.push_back(nodes[0]);
 
-	double max_info_gain = -numeric_limits<double>::infinity();
-	if (is_discrete) {
-		for (size_t y = 0; y < input_data[0].size() - 1; y++) {
-			double var_info_gain = calculateInfoGain(input_data, y, -1, label_entropy);
-			if (var_info_gain > max_info_gain) {
-				best_split_var = y;
-				max_info_gain = var_info_gain;
-			}
-		}
-	} else {
-		for (size_t y = 0; y < input_data[0].size() - 1; y++) {
-			vd thresholds = getThresholds(input_data, y);
-			for (size_t x = 0; x < thresholds.size(); x++) {
-				double var_info_gain = calculateInfoGain(input_data, y, thresholds[x], label_entropy);
-				if (var_info_gain > max_info_gain) {
-					best_split_var = y;
-					best_threshold = thresholds[x];
-					max_info_gain = var_info_gain;
-				}
-			}
+	for (size_t x = 0; x < compacted.size(); x++) {
+		int first_child = compacted[x].first_child;
+		int num_children = compacted[x].num_children;
+		if (num_children == 0) continue;
+		compacted[x].first_child = compacted.size();
+		for (int c = 0; c < num_children; c++) {
+			compacted.push_back(nodes[first_child + c]);
 		}
 	}
 
-	return make_tuple(best_split_var, best_threshold);
+	nodes = move(compacted);
 }
 
 /*
-* NOTE: future improvements could include restructuring the procedure to use a general (i.e. base) 
-*       case entropy calculation function then have other calculations (e.g. conditional entropy) 
-*       call that base case function
+* Returns: - [double] the number of misclassified rows, or the squared error for regression
 */
-double decisionTree::calculateEntropy(vvd& input_data, int idx, double threshold)
+double decisionTree::getValidationError(vvd& validation_data, vd& validation_labels)
 {
-	double entropy = 0;
+	double error = 0;
 
-	if (idx == input_data[0].size() - 1) {
-		for (map<double,int>::iterator itr = labels.begin(); itr != labels.end(); ++itr) {
-			double prob = (double) itr->second / input_data.size();
-			double label_entropy = 0;
-			if (prob != 0) {
-				label_entropy = -prob * log2(prob);
-			}
-			entropy += label_entropy;
-		}
-	} else {
-		if (is_discrete) {
-            // some helpful information regarding the variables var_val_counts and var_label_counts:
-            //   - var_val_counts:
-            //     Tracks the number of occurrences of every possible discrete value corresponding to 
-            //     the feature at idx. References data_info which, in turn, stores the relevant 
-            //     possible discrete values.
-            //
-            //   - var_label_counts:
-            //     Tracks the number of occurrences of each label per every possible discrete value 
-            //     corresponding to the feature at idx. So, for example, the feature at idx could 
-            //     have the following possible values with the following frequencies of labels:
-            //       - 0 -> label 1: 3
-            //           -> label 2: 0
-            //           -> label 3: 1
-            //       - 3 -> label 1: 1
-            //           -> label 2: 0
-            //           -> label 3: 0
-            //       - 4 -> label 1: 0
-            //           -> label 2: 0
-            //           -> label 3: 4
-			vector<int> var_val_counts(data_info[idx].size());
-			vector<vector<int>> var_label_counts(data_info[idx].size(), vector<int>(labels.size()));
-			for (size_t x = 0; x < input_data.size(); x++) {
-				double val = input_data[x][idx];
-				ptrdiff_t val_pos = distance(data_info[idx].begin(), find(data_info[idx].begin(), data_info[idx].end(), val));
-				var_val_counts[val_pos]++;
-				double label = input_data[x][input_data[x].size() - 1];
-				ptrdiff_t label_pos = distance(labels.begin(), labels.find(label));
-				var_label_counts[val_pos][label_pos]++;
-			}
-			// H(Y|X)
-			for (size_t y = 0; y < data_info[idx].size(); y++) {
-				// P(X = x_j)
-				double var_prob = (double) var_val_counts[y] / input_data.size();
-				// calculating conditional entropy
-				double cond_entropy = 0;
-				for (size_t lbl = 0; lbl < var_label_counts[y].size(); lbl++) {
-					// P(Y = y_i | X = x_j)
-                    double label_prob = 0;
-                    if (var_val_counts[y] != 0) {
-                        label_prob = (double) var_label_counts[y][lbl] / var_val_counts[y];
-                    }
-					double label_entropy = 0;
-					if (label_prob != 0) {
-						label_entropy = label_prob * log2(label_prob);
-					}
-					cond_entropy += label_entropy;
-				}
-				double var_entropy = -var_prob * cond_entropy;
-				entropy += var_entropy;
-			}
+	for (size_t x = 0; x < validation_data.size(); x++) {
+		double diff = validation_labels[x] - predict(validation_data[x]);
+		if (is_classification) {
+			if (diff != 0) error++;
 		} else {
-            // the variables var_val_counts and var_label counts work similarly to the discrete 
-            // case except they only consider the variables greater than or equal to and less 
-            // than the given threshold
-			vector<int> var_val_counts(2);
-			vector<vector<int>> var_label_counts(2, vector<int>(labels.size()));
-			for (size_t x = 0; x < input_data.size(); x++) {
-				double val = input_data[x][idx];
-				int val_pos;
-				if (val < threshold) {
-					val_pos = 0;
-				} else {
-					val_pos = 1;
-				}
-				var_val_counts[val_pos]++;
-				double label = input_data[x][input_data[x].size() - 1];
-				ptrdiff_t label_pos = distance(labels.begin(), labels.find(label));
-				var_label_counts[val_pos][label_pos]++;
-			}
-			// H(Y|X)
-			for (int y = 0; y < 2; y++) {
-				// P(X = x_j)
-				double var_prob = (double) var_val_counts[y] / input_data.size();
-				// calculating conditional entropy
-				double cond_entropy = 0;
-				for (size_t lbl = 0; lbl < var_label_counts[y].size(); lbl++) {
-					// P(Y = y_i | X = x_j)
-					double label_prob = 0;
-					if (var_val_counts[y] != 0) {
-						label_prob = (double) var_label_counts[y][lbl] / var_val_counts[y];
-					}
-					double label_entropy = 0;
-					if (label_prob != 0) {
-						label_entropy = label_prob * log2(label_prob);
-					}
-					cond_entropy += label_entropy;
-				}
-				double var_entropy = -var_prob * cond_entropy;
-				entropy += var_entropy;
-			}
+			error += diff * diff;
 		}
 	}
 
-	return entropy;
+	return error;
 }
 
-double decisionTree::calculateInfoGain(vvd& input_data, int idx, double threshold, double base_entropy)
+int decisionTree::countNodes(int node_idx, bool leaves_only)
 {
-	double info_gain = 0;
+	if (nodes[node_idx].is_leaf) return 1;
 
-	double entropy = calculateEntropy(input_data, idx, threshold);
-	info_gain = base_entropy - entropy;
+	int count = leaves_only ? 0 : 1;
+	for (int x = 0; x < nodes[node_idx].num_children; x++) {
+		count += countNodes(nodes[node_idx].first_child + x, leaves_only);
+	}
 
-	return info_gain;
+	return count;
 }
 
-vd decisionTree::getThresholds(vvd& input_data, int idx)
+int decisionTree::getDepth(int node_idx)
 {
-	vd thresholds;
-
-    vd candidates;
-    for (size_t i = 0; i < input_data.size(); i++) {
-        candidates.push_back(input_data[i][idx]);
-    }
-    sort(candidates.begin(), candidates.end());
+	int depth = 0;
 
-    double split = candidates[0];
-    for (size_t x = 1; x < candidates.size(); x++) {
-		double next_candidate = candidates[x];
-		if (next_candidate != split) {
-			double threshold = (next_candidate + split) / (double) 2;
-			thresholds.push_back(threshold);
-			split = next_candidate;
-		}
+	for (int x = 0; x < nodes[node_idx].num_children; x++) {
+		depth = max(depth, 1 + getDepth(nodes[node_idx].first_child + x));
 	}
 
-	return thresholds;
+	return depth;
 }
 
-vvd decisionTree::subsetDiscreteData(vvd& input_data, int var, double var_value)
+/*
+* Returns: - [double] the majority label of the node stats (the smallest label on ties), or the
+*            mean label for regression
+*/
+double decisionTree::getCutoffLeafLabel(vd& stats)
 {
-	vvd subset_data;
+	if (!is_classification) return stats[1] / stats[0];
 
-	for (size_t x = 0; x < input_data.size(); x++) {
-		if (input_data[x][var] == var_value) {
-			vd data_copy = input_data[x];
-			data_copy.erase(data_copy.begin() + var);
-			subset_data.push_back(data_copy);
+	double best_label = workspace->class_values[0];
+	double best_count = -1;
+	for (size_t lbl = 0; lbl < stats.size(); lbl++) {
+		if (stats[lbl] > best_count) {
+			best_label = workspace->class_values[lbl];
+			best_count = stats[lbl];
 		}
 	}
 
-	return subset_data;
+	return best_label;
 }
 
-vector<vvd> decisionTree::subsetContinuousData(vvd& input_data, int var, double threshold)
+/*
+* Returns: - [double] the number of rows not labeled label, or the squared error of label for regression
+*/
+double decisionTree::getLeafError(const int* rows, size_t count, vd& stats, double label)
 {
-	vector<vvd> subset_data;
-
-	vvd left_subtree_data;
-	vvd right_subtree_data;
-
-	for (size_t x = 0; x < input_data.size(); x++) {
-		double val = input_data[x][var];
-		if (val < threshold) {
-			left_subtree_data.push_back(input_data[x]);
-		} else {
-			right_subtree_data.push_back(input_data[x]);
-		}
+	if (is_classification) {
+		vd& class_values = workspace->class_values;
+		ptrdiff_t label_pos = distance(class_values.begin(), lower_bound(class_values.begin(), class_values.end(), label));
+		return accumulate(stats.begin(), stats.end(), 0.0) - stats[label_pos];
 	}
 
-	subset_data.push_back(left_subtree_data);
-	subset_data.push_back(right_subtree_data);
+	double error = 0;
+	for (size_t x = 0; x < count; x++) {
+		double diff = (*train_data)[rows[x]].back() - label;
+		error += workspace->weights[rows[x]] * diff * diff;
+	}
 
-	return subset_data;
+	return error;
 }
 
 /*
-* Currently not implemented. Prospective improvement involves using misclassification 
-* for the error while iterating over subtrees to detect the best accuracy improvements/ 
-* error reductions.
-*
-* In place, if the tree is not part of a random forest, minimum dataset sizes are used 
-* to limit the size of the tree.
+* Draws size distinct rows at random from the rows in [start, end) into the workspace's sample_rows.
+* A weighted row counts as that many rows (so it can be drawn several times), the number of times
+* each sampled row was drawn is its weight in sample_weights.
 */
-/*
-node* decisionTree::pruneTree()
+void decisionTree::getForestNodeData(size_t start, size_t end, int size)
 {
+	treeWorkspace& ws = *workspace;
+	size_t count = end - start;
+	ws.sample_rows.clear();
 
-}
-*/
-
-double decisionTree::getCutoffLeafLabel()
-{
-	double best_label;
+	vector<size_t>& weight_sums = ws.weight_sums;
+	weight_sums.resize(count);
+	size_t total_weight = 0;
+	for (size_t x = 0; x < count; x++) {
+		total_weight += ws.row_weights[ws.rows[start + x]];
+		weight_sums[x] = total_weight;
+	}
 
-	int best_count = -1;
-	for (map<double,int>::iterator itr = labels.begin(); itr != labels.end(); ++itr) {
-		int count = itr->second;
-		if (count > best_count) {
-			best_label = itr->first;
-			best_count = count;
+	int num_drawn = 0;
+	while (num_drawn < size) {
+		size_t rand_idx = rng() % total_weight;
+		if (!ws.row_marks[rand_idx]) {
+			int row = ws.rows[start + (upper_bound(weight_sums.begin(), weight_sums.end(), rand_idx) - weight_sums.begin())];
+			if (ws.sample_weights[row] == 0) ws.sample_rows.push_back(row);
+			ws.sample_weights[row]++;
+			ws.row_marks[rand_idx] = 1;
+			num_drawn++;
 		}
 	}
-
-	return best_label;
+	fill(ws.row_marks.begin(), ws.row_marks.begin() + total_weight, 0);
 }
 
-vvd decisionTree::getForestNodeData(vvd& input_data, int size)
+/*
+* Returns: - [int] the position in the node pool of the leaf the data point lands in
+*/
+int decisionTree::findLeaf(vd& data)
 {
-	vvd random_data;
-	vector<int> used_nums;
+	int node_idx = 0;
 
-	while (random_data.size() < (size_t) size) {
-		int rand_idx = rand() % input_data.size();
-		if (find(used_nums.begin(), used_nums.end(), rand_idx) == used_nums.end()) {
-			random_data.push_back(input_data[rand_idx]);
-			used_nums.push_back(rand_idx);
-		}
+	while (!nodes[node_idx].is_leaf) {
+		node_idx = nodes[node_idx].first_child + selectChild(nodes[node_idx], data);
 	}
 
-	return random_data;
-}
-
-double decisionTree::predict(vd& data, node current_node)
-{
-	if (current_node.is_leaf) return current_node.label;
-	if (is_discrete) {
-		double data_val = data[current_node.split_var];
-		int child_idx;
-		int max_freq = -1;
-		for (size_t x = 0; x < current_node.children.size(); x++) {
-			double val = current_node.children[x].split_val;
-			if (val == data_val) return predict(data, current_node.children[x]);
-			int freq = current_node.children[x].frequency;
-			if (freq > max_freq) {
-				max_freq = freq;
-				child_idx = x;
-			}
-		}
-		// if the data contains a value never seen before, throw it into the node 
-		// with the highest frequency
-		return predict(data, current_node.children[child_idx]);
-	}
-	else {
-		if (data[current_node.split_var] < current_node.threshold) return predict(data, current_node.children[0]);
-		return predict(data, current_node.children[1]);
-	}
+	return node_idx;
 }
 
-void decisionTree::printTree(node node_ref, int depth)
+void decisionTree::printTree(int node_idx, int depth, int parent_var)
 {
+	const node& node_ref = nodes[node_idx];
 	if (node_ref.is_leaf) {
 		printSpacing(depth, true);
 		wcout << L"Split Variable: " << node_ref.split_var << "\n";
         if (is_discrete) {
-            printSpacing(depth, false);
-            wcout << L"Split Value: " << node_ref.split_val << "\n";
+            printSplitValues(node_ref, parent_var, depth);
         }
         else {
             printSpacing(depth, false);
@@ -543,8 +1588,7 @@ void decisionTree::printTree(node node_ref, int depth)
 		printSpacing(depth, true);
 		wcout << L"Split Variable: " << node_ref.split_var << "\n";
 		if (is_discrete) {
-			printSpacing(depth, false);
-			wcout << L"Split Value: " << node_ref.split_val << "\n";
+			printSplitValues(node_ref, parent_var, depth);
 		}
 		else {
 			printSpacing(depth, false);
@@ -553,13 +1597,33 @@ void decisionTree::printTree(node node_ref, int depth)
 		printSpacing(depth, false);
 		wcout << L"Subtree Size: " << node_ref.frequency << "\n";
 		depth++;
-		for (size_t x = 0; x < node_ref.children.size(); x++) {
-			printTree(node_ref.children[x], depth);
+		for (int x = 0; x < node_ref.num_children; x++) {
+			printTree(node_ref.first_child + x, depth, node_ref.split_var);
 		}
 		return;
 	}
 }
 
+/*
+* Prints the value (or, with partition splits, the values) of the parent's split variable that 
+* lead to the node.
+*/
+void decisionTree::printSplitValues(const node& node_ref, int parent_var, int depth)
+{
+	printSpacing(depth, false);
+	if (parent_var == -1 || isMultiwayFeature(parent_var)) {
+		wcout << L"Split Value: " << node_ref.split_val << "\n";
+		return;
+	}
+
+	wcout << L"Split Values:";
+	const vd& values = categories[parent_var];
+	for (size_t c = 0; c < values.size(); c++) {
+		if ((node_ref.category_mask >> c) & 1) wcout << L" " << values[c];
+	}
+	wcout << "\n";
+}
+
 void decisionTree::printSpacing(int depth, bool is_top)
 {
 	if (depth > 0) {
@@ -575,41 +1639,28 @@ void decisionTree::printSpacing(int depth, bool is_top)
 	}
 }
 
-double decisionTree::processStats(vd& test_labels, vd& test_predictions, wstring filename)
+// Public Functions
+/*
+* Returns: - [double] the predicted label for the input data
+*/
+double decisionTree::predict(vd& data)
 {
-	ofstream output_file;
-	output_file.open(filename);
-	int correct = 0;
-
-	output_file << setw(2) << "#" << setw(10) << "True Label" << setw(30) << right << "Predicted Label\n";
-	output_file << "----------------------------------------------------------------" << endl;
-	for (size_t x = 0; x < test_labels.size(); x++) {
-		output_file << setw(2) << x + 1 << setw(10) << test_labels[x];
-		if (test_labels[x] == test_predictions[x]) {
-			correct++;
-			output_file << "            ";
-		}
-		else {
-			output_file << "  ********  ";
-		}
-		output_file << test_predictions[x] << endl;
-	}
-
-	output_file << "----------------------------------------------------------------" << endl;
-	output_file << "Size of the test dataset: " << test_labels.size() << "\n";
-	output_file << "Number of correctly predicted labels: " << correct << endl;
-	output_file.close();
-
-	return (double) correct / test_labels.size();
+	return nodes[findLeaf(data)].label;
 }
 
-// Public Functions
 /*
+* Version of predict that also rates how sure the leaf is of its label (classification only): 
+* confidence is set to the share of the leaf's training rows that have the label, smoothed as 
+* (correct rows + 1) / (rows + 2) so that a leaf with a handful of rows is never fully trusted.
+*
 * Returns: - [double] the predicted label for the input data
 */
-double decisionTree::predict(vd& data)
+double decisionTree::predict(vd& data, double& confidence)
 {
-	return predict(data, root_node);
+	const node& leaf = nodes[findLeaf(data)];
+	confidence = (leaf.frequency - leaf.error + 1) / (leaf.frequency + 2);
+
+	return leaf.label;
 }
 
 /*
@@ -628,20 +1679,274 @@ vd decisionTree::predict(vvd& dataset)
 	return predicted_labels;
 }
 
+/*
+* Sparse version of predict for the data point at row of a CSR matrix.
+*
+* Returns: - [double] the predicted label for the data point
+*/
+double decisionTree::predict(csrMatrix& dataset, int row)
+{
+	int node_idx = 0;
+	while (!nodes[node_idx].is_leaf) {
+		const node& node_ref = nodes[node_idx];
+		double val = getSparseValue(dataset, row, node_ref.split_var);
+		node_idx = node_ref.first_child + ((val < node_ref.threshold) ? 0 : 1);
+	}
+
+	return nodes[node_idx].label;
+}
+
+/*
+* Returns: - [vd] the list of predicted labels for each row of the sparse dataset
+*/
+vd decisionTree::predict(csrMatrix& dataset)
+{
+	vd predicted_labels;
+
+	for (int x = 0; x < dataset.num_rows; x++) {
+		predicted_labels.push_back(predict(dataset, x));
+	}
+
+	return predicted_labels;
+}
+
+/*
+* Replaces the label of every leaf with sum(numerators) / sum(denominators) over the rows of 
+* dataset that land in it, leaves that no row reaches keep their label. Used by boosting to 
+* turn the mean residual of a leaf into a Newton step.
+*/
+void decisionTree::refitLeaves(vvd& dataset, vd& numerators, vd& denominators)
+{
+	vd leaf_numerators(nodes.size());
+	vd leaf_denominators(nodes.size());
+	vector<char> reached(nodes.size());
+
+	for (size_t x = 0; x < dataset.size(); x++) {
+		int leaf = findLeaf(dataset[x]);
+		leaf_numerators[leaf] += numerators[x];
+		leaf_denominators[leaf] += denominators[x];
+		reached[leaf] = 1;
+	}
+
+	for (size_t x = 0; x < nodes.size(); x++) {
+		if (!reached[x]) continue;
+		nodes[x].label = (leaf_denominators[x] > 1e-12) ? leaf_numerators[x] / leaf_denominators[x] : 0;
+	}
+}
+
+/*
+* Computes the cost-complexity pruning path by repeatedly collapsing the weakest link of a copy 
+* of the tree until only the root is left. Pruning with any alpha between two consecutive values 
+* of the path gives the same subtree.
+*
+* Returns: - [vd] the increasing alphas at which the pruned subtree changes, starting at 0
+*/
+vd decisionTree::getPruningPath()
+{
+	vd alphas(1, 0);
+	vector<node> full_nodes = nodes;
+
+	while (!nodes[0].is_leaf) {
+		int weakest = -1;
+		double min_strength = numeric_limits<double>::infinity();
+		double subtree_error;
+		int subtree_leaves;
+		findWeakestLink(0, weakest, min_strength, subtree_error, subtree_leaves);
+		collapseNode(weakest);
+		double alpha = max(0.0, min_strength);
+		if (alpha > alphas[alphas.size() - 1]) alphas.push_back(alpha);
+	}
+	nodes = move(full_nodes);
+
+	return alphas;
+}
+
+/*
+* Prunes the tree to the smallest subtree minimizing R(T) + alpha * |leaves(T)|, where R is the 
+* training error (stored in each node) as a fraction of the training data.
+*/
+void decisionTree::costComplexityPrune(double alpha)
+{
+	pruneCostComplexity(0, alpha);
+	compactNodes();
+}
+
+/*
+* Picks the alpha on the pruning path whose subtree has the lowest validation error, preferring 
+* the larger alpha (i.e. the smaller tree) on ties. The tree itself is left unpruned.
+*
+* Returns: - [double] the selected alpha
+*/
+double decisionTree::selectPruningAlpha(vvd& validation_data, vd& validation_labels)
+{
+	vd alphas = getPruningPath();
+	vector<node> full_nodes = nodes;
+	double best_alpha = 0;
+	double best_error = numeric_limits<double>::infinity();
+
+	for (size_t x = 0; x < alphas.size(); x++) {
+		// use the geometric midpoint of each interval so the subtree is not on a boundary
+		double alpha = (x + 1 < alphas.size() && alphas[x] > 0) ? sqrt(alphas[x] * alphas[x + 1]) : alphas[x];
+		nodes = full_nodes;
+		costComplexityPrune(alpha);
+		double error = getValidationError(validation_data, validation_labels);
+		if (error <= best_error) {
+			best_error = error;
+			best_alpha = alpha;
+		}
+	}
+	nodes = move(full_nodes);
+
+	return best_alpha;
+}
+
+/*
+* Reduced-error pruning: collapses every subtree that does not beat its root as a leaf on the 
+* validation data. Subtrees that no validation row reaches are collapsed as well.
+*/
+void decisionTree::reducedErrorPrune(vvd& validation_data, vd& validation_labels)
+{
+	vector<int> rows;
+	for (size_t x = 0; x < validation_data.size(); x++) {
+		rows.push_back(x);
+	}
+	pruneReducedError(0, validation_data, validation_labels, rows);
+	compactNodes();
+}
+
+int decisionTree::getNodeCount()
+{
+	return countNodes(0, false);
+}
+
+int decisionTree::getLeafCount()
+{
+	return countNodes(0, true);
+}
+
+int decisionTree::getDepth()
+{
+	return getDepth(0);
+}
+
 void decisionTree::print()
 {
 	wcout << L"Tree Structure:\n";
 	wcout << L"----------------------------------------------------------------\n";
-	printTree(root_node, 0);
+	printTree(0, 0, -1);
+}
+
+/*
+* Writes the tree as text: a "tree <discrete> <classification> <multiway> <node count> <feature count>" 
+* line, the sorted categories of each feature used by partition splits ("<count> <values...>", 
+* "0" for a feature split multiway, no features otherwise), then one line per node of the pool, with enough digits for every 
+* double to read back exactly.
+*/
+void decisionTree::save(ostream& output)
+{
+	streamsize precision = output.precision(numeric_limits<double>::max_digits10);
+
+	output << "tree " << is_discrete << " " << is_classification << " " << is_multiway << " " << nodes.size() << " " << categories.size() << "\n";
+	for (size_t y = 0; y < categories.size(); y++) {
+		output << categories[y].size();
+		for (size_t c = 0; c < categories[y].size(); c++) {
+			output << " " << categories[y][c];
+		}
+		output << "\n";
+	}
+	for (size_t x = 0; x < nodes.size(); x++) {
+		const node& node_ref = nodes[x];
+		output << node_ref.is_leaf << " " << node_ref.label << " " << node_ref.split_var << " " << node_ref.split_val << " " 
+			<< node_ref.threshold << " " << node_ref.frequency << " " << node_ref.error << " " << node_ref.first_child << " " 
+			<< node_ref.num_children << " " << node_ref.category_mask << "\n";
+	}
+	output.precision(precision);
 }
 
 double decisionTree::getStatsInfo(vd& test_labels, vd& test_predictions, wstring filename)
 {
 	wcout << L"Statistics:\n";
 	wcout << L"----------------------------------------------------------------\n";
-	double accuracy = processStats(test_labels, test_predictions, filename);
+	statsAccumulator stats = writeStatsReport(test_labels, test_predictions, filename, is_classification);
 	wcout << L"NOTE: testing results recorded at " << filename << "\n";
-	wcout << L"\nModel Accuracy on Test Data: " << accuracy << endl;
+	stats.print();
+
+	return stats.getAccuracy();
+}
 
-	return accuracy;
-}
\ No newline at end of file
+/*
+* Precomputes up to max_bins candidate thresholds per feature column (the midpoints between 
+* consecutive unique values, thinned out evenly by rank when there are too many). Computing 
+* these once and handing them to every tree via treeOptions skips the per-node column sort, 
+* which is what lets the cross-validation engine share the work across folds and settings.
+*
+* Returns: - [vvd] the sorted thresholds for each feature column (the label column is skipped)
+*/
+vvd decisionTree::getBinnedThresholds(vvd& dataset, int max_bins)
+{
+	vvd binned;
+
+	for (size_t y = 0; y < dataset[0].size() - 1; y++) {
+		vd values;
+		for (size_t x = 0; x < dataset.size(); x++) {
+			values.push_back(dataset[x][y]);
+		}
+		sort(values.begin(), values.end());
+		values.erase(unique(values.begin(), values.end()), values.end());
+
+		vd thresholds;
+		for (size_t x = 1; x < values.size(); x++) {
+			thresholds.push_back((values[x - 1] + values[x]) / (double) 2);
+		}
+		if (max_bins > 0 && thresholds.size() > (size_t) max_bins) {
+			vd thinned;
+			for (int b = 0; b < max_bins; b++) {
+				thinned.push_back(thresholds[(size_t) (((double) b + 0.5) * thresholds.size() / max_bins)]);
+			}
+			thresholds = thinned;
+		}
+		binned.push_back(thresholds);
+	}
+
+	return binned;
+}
+
+/*
+* Returns: - [int] the number of distinct rows (features and label) of the dataset, i.e. the rows 
+*            trees train on once its duplicates are collapsed (see prepareWorkspace)
+*/
+int decisionTree::getDistinctRowCount(vvd& dataset)
+{
+	rowHash hasher = { &dataset };
+	rowEqual comparer = { &dataset };
+	unordered_set<int, rowHash, rowEqual> distinct_features(dataset.size(), hasher, comparer);
+	set<pair<int,double>> distinct_rows;
+
+	for (size_t x = 0; x < dataset.size(); x++) {
+		int group = *distinct_features.insert(x).first;
+		distinct_rows.insert(make_pair(group, dataset[x].back()));
+	}
+
+	return distinct_rows.size();
+}
+
+size_t rowHash::operator()(int row) const
+{
+	const vd& values = (*data)[row];
+	size_t hash = 0;
+
+	for (size_t y = 0; y + 1 < values.size(); y++) {
+		// adding 0.0 turns -0.0 into 0.0, which compares equal to it
+		hash ^= std::hash<double>()(values[y] + 0.0) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	return hash;
+}
+
+bool rowEqual::operator()(int first_row, int second_row) const
+{
+	const vd& first_values = (*data)[first_row];
+	const vd& second_values = (*data)[second_row];
+
+	return equal(first_values.begin(), first_values.end() - 1, second_values.begin());
+}
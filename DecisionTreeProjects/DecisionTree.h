@@ -6,65 +6,218 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <algorithm>
 #include <tuple>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <cstdint>
+#include <unordered_set>
+#include <numeric>
 
 using namespace std;
 
 typedef vector<double> vd;
 typedef vector<vd> vvd;
 
+struct csrMatrix;
+struct sparseContext;
+
 struct node
 {
 	bool is_leaf = false;
-	double label; // if leaf node, contains label, else...
+	double label; // if leaf node, contains label, else the label the node would predict if pruned
 	int split_var = -1; // contains attribute split label
 	double split_val = -1; // NOTE: only used in discrete data trees
 	double threshold = -1; // NOTE: only used in continous data trees
+	uint64_t category_mask = 0; // NOTE: only used in discrete data trees with partition splits, bit i is set if the i-th category of split_var leads to this node
 	int frequency = 1;
-	vector<node> children;
+	double error = 0; // training error of the node as a leaf (misclassified rows, or squared error for regression)
+	int first_child = -1; // position of the first child in the tree's node pool, the children are contiguous
+	int num_children = 0;
+};
+
+// scratch space for growing trees, reused across the nodes of a tree and (through treeOptions) 
+// across the trees of a forest so that growing a tree does not allocate per node or per row
+// NOTE: a workspace caches encodings of the training data, it must only be shared by trees 
+//       trained on the same, unchanged, dataset
+struct treeWorkspace
+{
+	const vvd* encoded_data = nullptr; // the dataset the encodings below were computed for
+	vvd categories; // discrete only: the distinct values of each feature column, in increasing order
+	vector<vector<int>> row_codes; // discrete only: position of each row's value in categories, per column
+	vd class_values; // classification only: the distinct labels in increasing order
+	vector<int> row_classes; // classification only: position of each row's label in class_values
+	vector<int> feature_groups; // the first row with the same feature values as each row, see prepareWorkspace
+	vector<int> group_heads; // the last distinct row found so far for each feature group, -1 if none
+	vector<int> next_duplicate; // the previous distinct row of the same feature group (other label), -1 if none
+	vector<int> rows; // the (distinct) training rows, partitioned in place so every node owns a contiguous range
+	vector<int> row_weights; // number of training rows each distinct row stands for, indexed by row
+	vector<int> sample_weights; // the same for the rows sampled at a forest node
+	const int* weights = nullptr; // the weights the node statistics are computed with, row_weights or sample_weights
+	vector<size_t> weight_sums; // running weights of the rows of a forest node, to sample it
+	vector<int> row_buffer; // scratch for the stable partitions
+	vector<char> row_marks; // marks the (weighted) positions already drawn when sampling a forest node
+	vector<int> sample_rows; // the rows sampled at a forest node
+	vector<size_t> child_bounds; // stack of the row ranges of the children of the nodes being built
+	vector<int> seen_codes; // the codes of one column in order of first appearance within a node
+	vector<int> code_positions; // position of each code in seen_codes, -1 if not seen
+	vector<size_t> code_cursors;
+	vd node_stats; // label counts (or count, sum and squared sum for regression) of the node being built
+	vd group_counts;
+	vd group_stats;
+	vd group_keys; // the value that orders the groups when searching category partitions
+	vector<int> group_order;
+	vector<int> candidate_features; // the features in the order they are drawn by randomSplitVar
+	vector<int> drawn_features;
+	vd total_stats;
+	vd left_stats;
+	vd right_stats;
+	uint64_t split_mask = 0; // the categories of the first child of the last split found by bestSplitVar
+	vd values;
+	vd thresholds;
+};
+
+// hashes and compares rows of a dataset by their feature values (the label is left out)
+struct rowHash
+{
+	const vvd* data;
+	size_t operator()(int) const;
+};
+
+struct rowEqual
+{
+	const vvd* data;
+	bool operator()(int, int) const;
+};
+
+// a leaf waiting to be expanded during best-first growth
+struct pendingLeaf
+{
+	double priority; // information gain (or variance reduction) weighted by the leaf's data size
+	int leaf; // position in the node pool
+	size_t start; // the leaf's range of rows in the workspace
+	size_t end;
+	vector<int> features; // the features still available to split on
+	int depth;
+	int split_var;
+	double threshold;
+	uint64_t category_mask;
+
+	bool operator<(const pendingLeaf& other) const { return priority < other.priority; }
+};
+
+// optional training settings shared by standalone trees, forests and the cross-validation engine
+struct treeOptions
+{
+	unsigned int seed = 1; // seeds the node sampling (and, in forests, the bootstrap samples)
+	int min_data_size = -1; // NOTE: only used by forests, -1 defaults to sqrt of the input data size
+	int max_depth = -1; // -1 means no depth limit
+	bool best_first = false; // grow leaf-wise (best gain first) instead of depth-first, see buildTreeBestFirst
+	int max_leaves = -1; // NOTE: only used in best-first growth, -1 means no leaf limit
+	size_t max_bytes = 0; // NOTE: only used in best-first growth, approximate node memory budget, 0 means no limit
+	const vvd* binned_thresholds = nullptr; // NOTE: only used in continous data trees, see getBinnedThresholds
+	bool multiway_splits = false; // NOTE: only used in discrete data trees, one child per value instead of a binary category partition
+	bool extra_trees = false; // split on random thresholds of a few random features, see randomSplitVar
+	bool bootstrap = true; // NOTE: only used by forests, false trains every tree on all the rows
+	const vector<int>* sample_rows = nullptr; // rows of the dataset to train on (repeats allowed), all rows if null
+	bool collapse_rows = true; // train on the distinct rows weighted by their number of copies, see prepareWorkspace
+	treeWorkspace* workspace = nullptr; // scratch space to reuse, a temporary one is used if null
+	bool verbose = true;
 };
 
 class decisionTree
 {
-	vvd data_info; // list (in order of input format) of all variables and possible values
-	map<double,int> labels;
-	node root_node;
+	vector<node> nodes; // node pool, the root is the first node
 	int min_data_size;
+	int max_depth;
+	int max_leaves;
+	size_t max_bytes;
 	bool is_discrete;
 	bool is_classification;
 	bool is_in_forest;
+	bool is_multiway; // discrete data trees only, see treeOptions::multiway_splits
+	bool extra_trees;
+	vvd categories; // NOTE: only used with partition splits, the sorted values of each feature (a value's position is its bit in the masks), empty for the features split multiway (see isMultiwayFeature)
+	const vvd* binned_thresholds;
+	minstd_rand rng;
+	// only set while the tree is being built
+	vvd* train_data;
+	treeWorkspace* workspace;
 
-	vvd getDatasetInfo(vvd&);
-	map<double,int> getLabelInfo(vvd&);
-	node buildTree(vvd&, vector<int>, node);
-	tuple<bool,double> checkLeaf(vvd&);
-	tuple<int,double> bestSplitVar(vvd&);
-	double calculateEntropy(vvd&, int, double);
-	double calculateInfoGain(vvd&, int, double, double);
-	vd getThresholds(vvd&, int);
-	vvd subsetDiscreteData(vvd&, int, double);
-	vector<vvd> subsetContinuousData(vvd&, int, double);
-	//node* pruneTree();
-	double getCutoffLeafLabel();
-	vvd getForestNodeData(vvd&, int);
-	double predict(vd&, node);
-	void printTree(node, int);
+	void prepareWorkspace(vvd&, const vector<int>*, bool);
+	void buildTree(size_t, size_t, vector<int>&, int, int);
+	void buildTreeBestFirst(vector<int>&);
+	bool evaluateLeaf(pendingLeaf&);
+	tuple<int,double,double> findNodeSplit(size_t, size_t, vector<int>&, int, int);
+	int partitionRows(size_t, size_t, int, double, uint64_t);
+	int getGroup(int, int, double);
+	void resetGroups();
+	void addChildren(int, int, double, uint64_t, size_t, int);
+	uint64_t getFeatureMask(int);
+	bool isMultiwayFeature(int);
+	void buildSparseTree(sparseContext&, size_t, size_t, int, int);
+	tuple<int,double,double> bestSparseSplit(sparseContext&, size_t, size_t, vd&);
+	void addSparseStats(sparseContext&, vd&, int, double);
+	double getImpurity(vd&);
+	void getNodeStats(const int*, size_t, vd&);
+	tuple<bool,double> checkLeaf(const int*, size_t, vector<int>&, vd&);
+	tuple<int,double,double> bestSplitVar(const int*, size_t, vector<int>&);
+	tuple<int,double,double> randomSplitVar(const int*, size_t, vector<int>&);
+	double calculateEntropy(const int*, size_t, int, double);
+	double calculateVariance(const int*, size_t, int, double);
+	double calculateInfoGain(const int*, size_t, int, double, double);
+	double bestCategoryPartition(const int*, size_t, int, double, uint64_t&);
+	void getThresholds(const int*, size_t, int);
+	int selectChild(const node&, vd&);
+	void findWeakestLink(int, int&, double&, double&, int&);
+	double pruneCostComplexity(int, double);
+	double pruneReducedError(int, vvd&, vd&, vector<int>&);
+	void collapseNode(int);
+	void compactNodes();
+	double getValidationError(vvd&, vd&);
+	int countNodes(int, bool);
+	int getDepth(int);
+	double getCutoffLeafLabel(vd&);
+	double getLeafError(const int*, size_t, vd&, double);
+	void getForestNodeData(size_t, size_t, int);
+	int findLeaf(vd&);
+	void printTree(int, int, int);
+	void printSplitValues(const node&, int, int);
 	void printSpacing(int, bool);
-	double processStats(vd&, vd&, wstring);
+
+	friend class compactForest;
+	friend class treeExplainer;
 
 public:
-	decisionTree(vvd&, int, bool, bool, bool);
+	decisionTree(vvd&, int, bool, bool, bool, treeOptions = treeOptions());
+	decisionTree(csrMatrix&, vd&, int, bool, treeOptions = treeOptions());
+	decisionTree(istream&);
 	//decisionTree(const decisionTree&);
 	//decisionTree& operator=(const decisionTree&);
 	//~decisionTree();
 	double predict(vd&);
+	double predict(vd&, double&);
 	vd predict(vvd&);
+	double predict(csrMatrix&, int);
+	vd predict(csrMatrix&);
+	void refitLeaves(vvd&, vd&, vd&);
+	vd getPruningPath();
+	void costComplexityPrune(double);
+	double selectPruningAlpha(vvd&, vd&);
+	void reducedErrorPrune(vvd&, vd&);
+	int getNodeCount();
+	int getLeafCount();
+	int getDepth();
 	void print();
+	void save(ostream&);
 	double getStatsInfo(vd&, vd&, wstring);
+	static vvd getBinnedThresholds(vvd&, int);
+	static int getDistinctRowCount(vvd&);
 };
 
 #endif
\ No newline at end of file
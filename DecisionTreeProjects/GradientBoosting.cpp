@@ -0,0 +1,310 @@
+#include "GradientBoosting.h"
+#include "Scoring.h"
+
+// Constructor
+/*
+*  Trains a gradient boosted ensemble of shallow regression trees.
+*
+*  The loss depends on the task:
+*    - regression: squared error, every tree is fit to the residuals of the current model
+*    - classification with two labels: logistic loss, one tree per round
+*    - classification with more labels: softmax loss, one tree per label per round
+*
+*  For classification each tree is fit to the negative gradient (one-hot label minus predicted 
+*  probability) and its leaves are then refit with a single Newton step. Every tree's output is 
+*  shrunk by the learning rate before being added to the model.
+*
+*  If validation data is given, the loss on it is tracked after every round and training stops 
+*  once it has not improved for early_stopping_rounds rounds. The ensemble is then truncated to 
+*  the round with the lowest validation loss.
+*/
+boostedForest::boostedForest(vvd& train_dataset, vvd& validation_data, vd& validation_labels, int max_rounds, double shrinkage, 
+	int max_depth, int early_stopping_rounds, bool discrete, bool classification, treeOptions options)
+{
+	learning_rate = shrinkage;
+	is_classification = classification;
+	size_t label_idx = train_dataset[0].size() - 1;
+
+	// the targets for each output, one-hot labels for classification
+	vvd targets(train_dataset.size());
+	if (is_classification) {
+		for (size_t x = 0; x < train_dataset.size(); x++) {
+			classes.push_back(train_dataset[x][label_idx]);
+		}
+		sort(classes.begin(), classes.end());
+		classes.erase(unique(classes.begin(), classes.end()), classes.end());
+		num_outputs = (classes.size() == 2) ? 1 : classes.size();
+		for (size_t x = 0; x < train_dataset.size(); x++) {
+			double label = train_dataset[x][label_idx];
+			if (num_outputs == 1) {
+				targets[x].push_back((label == classes[1]) ? 1 : 0);
+			} else {
+				for (int k = 0; k < num_outputs; k++) {
+					targets[x].push_back((label == classes[k]) ? 1 : 0);
+				}
+			}
+		}
+	} else {
+		num_outputs = 1;
+		for (size_t x = 0; x < train_dataset.size(); x++) {
+			targets[x].push_back(train_dataset[x][label_idx]);
+		}
+	}
+
+	// start from the log prior (or log odds) of each label, or the mean label for regression
+	base_scores.assign(num_outputs, 0);
+	for (size_t x = 0; x < targets.size(); x++) {
+		for (int k = 0; k < num_outputs; k++) {
+			base_scores[k] += targets[x][k] / targets.size();
+		}
+	}
+	if (is_classification) {
+		for (int k = 0; k < num_outputs; k++) {
+			double prior = min(max(base_scores[k], 1e-6), 1 - 1e-6);
+			base_scores[k] = (num_outputs == 1) ? log(prior / (1 - prior)) : log(prior);
+		}
+	}
+	if (is_classification && classes.size() < 2) return;
+
+	vvd train_scores(train_dataset.size(), base_scores);
+	vvd validation_scores(validation_data.size(), base_scores);
+	bool use_validation = !validation_data.empty();
+	double best_loss = use_validation ? calculateLoss(validation_scores, validation_labels) : numeric_limits<double>::infinity();
+	int best_rounds = 0;
+
+	int data_cutoff = (options.min_data_size > 0) ? options.min_data_size : (int) sqrt(train_dataset.size());
+	treeOptions tree_options = options;
+	tree_options.max_depth = max_depth;
+	vvd work_data = train_dataset;
+	// only the residual labels change between rounds, so every tree can share one workspace
+	treeWorkspace workspace;
+	tree_options.workspace = &workspace;
+	vd numerators(train_dataset.size());
+	vd denominators(train_dataset.size());
+	double newton_scale = (num_outputs == 1) ? 1 : (num_outputs - 1) / (double) num_outputs;
+
+	for (int round = 0; round < max_rounds; round++) {
+		vvd probabilities = is_classification ? getProbabilities(train_scores) : vvd();
+		for (int k = 0; k < num_outputs; k++) {
+			for (size_t x = 0; x < work_data.size(); x++) {
+				double residual = targets[x][k] - (is_classification ? probabilities[x][k] : train_scores[x][k]);
+				work_data[x][label_idx] = residual;
+				numerators[x] = newton_scale * residual;
+				denominators[x] = fabs(residual) * (1 - fabs(residual));
+			}
+			forest.emplace_back(work_data, data_cutoff, discrete, false, false, tree_options);
+			if (is_classification) forest.back().refitLeaves(work_data, numerators, denominators);
+		}
+		addTreeScores(train_dataset, train_scores, forest.size() - num_outputs);
+		addTreeScores(validation_data, validation_scores, forest.size() - num_outputs);
+
+		if (use_validation) {
+			double loss = calculateLoss(validation_scores, validation_labels);
+			if (loss < best_loss) {
+				best_loss = loss;
+				best_rounds = round + 1;
+			} else if (round + 1 - best_rounds >= early_stopping_rounds) {
+				break;
+			}
+		} else {
+			best_rounds = round + 1;
+		}
+	}
+
+	forest.erase(forest.begin() + best_rounds * num_outputs, forest.end());
+	if (options.verbose) {
+		wcout << L"Boosting stopped after " << best_rounds << L" rounds (" << forest.size() << L" trees)\n";
+	}
+}
+
+/*
+*  Constructor that reads back a boosted forest written by save, it predicts exactly like the 
+*  saved one.
+*/
+boostedForest::boostedForest(istream& input)
+{
+	string tag;
+	size_t num_classes = 0;
+	size_t num_trees = 0;
+	input >> tag >> is_classification >> num_outputs >> learning_rate >> num_classes >> num_trees;
+	if (!input || tag != "boosted" || num_outputs < 1) {
+		wcout << L"ERROR: invalid boosted forest model file, please check for errors" << endl;
+		exit(-1);
+	}
+	classes.resize(num_classes);
+	for (size_t c = 0; c < num_classes; c++) {
+		input >> classes[c];
+	}
+	base_scores.resize(num_outputs);
+	for (int k = 0; k < num_outputs; k++) {
+		input >> base_scores[k];
+	}
+	if (!input) {
+		wcout << L"ERROR: invalid boosted forest model file, please check for errors" << endl;
+		exit(-1);
+	}
+
+	forest.reserve(num_trees);
+	for (size_t x = 0; x < num_trees; x++) {
+		forest.emplace_back(input);
+	}
+}
+
+// Private (Internal) Functions
+vd boostedForest::getRawScores(vd& data)
+{
+	vd scores = base_scores;
+
+	for (size_t x = 0; x < forest.size(); x++) {
+		scores[x % num_outputs] += learning_rate * forest[x].predict(data);
+	}
+
+	return scores;
+}
+
+/*
+* Adds the shrunk outputs of the trees from first_tree onwards to the running scores of dataset.
+*/
+void boostedForest::addTreeScores(vvd& dataset, vvd& scores, size_t first_tree)
+{
+	for (size_t t = first_tree; t < forest.size(); t++) {
+		for (size_t x = 0; x < dataset.size(); x++) {
+			scores[x][t % num_outputs] += learning_rate * forest[t].predict(dataset[x]);
+		}
+	}
+}
+
+vvd boostedForest::getProbabilities(vvd& scores)
+{
+	vvd probabilities(scores.size(), vd(num_outputs));
+
+	for (size_t x = 0; x < scores.size(); x++) {
+		if (num_outputs == 1) {
+			probabilities[x][0] = 1 / (1 + exp(-scores[x][0]));
+		} else {
+			double max_score = *max_element(scores[x].begin(), scores[x].end());
+			double total = 0;
+			for (int k = 0; k < num_outputs; k++) {
+				probabilities[x][k] = exp(scores[x][k] - max_score);
+				total += probabilities[x][k];
+			}
+			for (int k = 0; k < num_outputs; k++) {
+				probabilities[x][k] /= total;
+			}
+		}
+	}
+
+	return probabilities;
+}
+
+/*
+* Returns: - [double] the mean log loss for classification, the mean squared error for regression
+*/
+double boostedForest::calculateLoss(vvd& scores, vd& true_labels)
+{
+	double loss = 0;
+
+	if (!is_classification) {
+		for (size_t x = 0; x < scores.size(); x++) {
+			loss += (scores[x][0] - true_labels[x]) * (scores[x][0] - true_labels[x]);
+		}
+		return loss / scores.size();
+	}
+
+	vvd probabilities = getProbabilities(scores);
+	for (size_t x = 0; x < scores.size(); x++) {
+		double prob;
+		if (num_outputs == 1) {
+			prob = (true_labels[x] == classes[1]) ? probabilities[x][0] : 1 - probabilities[x][0];
+		} else {
+			ptrdiff_t label_pos = distance(classes.begin(), find(classes.begin(), classes.end(), true_labels[x]));
+			prob = (label_pos < num_outputs) ? probabilities[x][label_pos] : 0;
+		}
+		loss -= log(max(prob, 1e-15));
+	}
+
+	return loss / scores.size();
+}
+
+// Public Functions
+/*
+* Returns: - [double] the predicted label for the input data
+*/
+double boostedForest::predict(vd& data)
+{
+	if (!is_classification) return getRawScores(data)[0];
+	if (classes.size() < 2) return classes[0];
+
+	vd scores = getRawScores(data);
+	if (num_outputs == 1) return (scores[0] > 0) ? classes[1] : classes[0];
+	return classes[distance(scores.begin(), max_element(scores.begin(), scores.end()))];
+}
+
+/*
+* Overloaded version of predict that can handle sets of data.
+*
+* Returns: - [vd] the list of predicted labels for each data point in the dataset
+*/
+vd boostedForest::predict(vvd& dataset)
+{
+	vd predicted_labels;
+
+	for (size_t x = 0; x < dataset.size(); x++) {
+		predicted_labels.push_back(predict(dataset[x]));
+	}
+
+	return predicted_labels;
+}
+
+void boostedForest::print(int sample_size)
+{
+	wcout << L"Taking Sample of Size " << sample_size << " from the Boosted Forest (" << forest.size() << " trees):\n";
+	wcout << L"----------------------------------------------------------------" << endl;
+	if (forest.empty()) return;
+	int step_size = max(1, (int) floor(forest.size() / (double) sample_size));
+	for (size_t x = 0; x < forest.size(); x += step_size) {
+		wcout << L"Boosted Forest: Tree " << x << "\n";
+		forest[x].print();
+		wcout << endl;
+	}
+}
+
+double boostedForest::getStatsInfo(vd& test_labels, vd& test_predictions, wstring filename)
+{
+	wcout << L"Statistics:\n";
+	statsAccumulator stats = writeStatsReport(test_labels, test_predictions, filename, is_classification);
+	wcout << L"NOTE: testing results recorded at " << filename << "\n";
+	stats.print();
+
+	return stats.getAccuracy();
+}
+
+int boostedForest::getNumRounds()
+{
+	if (num_outputs == 0) return 0;
+	return forest.size() / num_outputs;
+}
+
+/*
+* Writes the boosted forest as text: a "boosted <classification> <outputs> <learning rate> <label count> 
+* <tree count>" line, the labels (classification only) and the base score of each output on one line 
+* each, then every tree in round order (see decisionTree::save).
+*/
+void boostedForest::save(ostream& output)
+{
+	streamsize precision = output.precision(numeric_limits<double>::max_digits10);
+
+	output << "boosted " << is_classification << " " << num_outputs << " " << learning_rate << " " << classes.size() << " " << forest.size() << "\n";
+	for (size_t c = 0; c < classes.size(); c++) {
+		output << (c > 0 ? " " : "") << classes[c];
+	}
+	output << "\n";
+	for (int k = 0; k < num_outputs; k++) {
+		output << (k > 0 ? " " : "") << base_scores[k];
+	}
+	output << "\n";
+	output.precision(precision);
+	for (size_t x = 0; x < forest.size(); x++) {
+		forest[x].save(output);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#ifndef GRADIENT_BOOSTING_H_
+#define GRADIENT_BOOSTING_H_
+
+#include "DecisionTree.h"
+
+class boostedForest
+{
+	vector<decisionTree> forest; // num_outputs trees per boosting round, in round order
+	vd classes; // the possible labels (classification only), in the order of the outputs
+	vd base_scores; // initial raw score of each output
+	double learning_rate;
+	int num_outputs;
+	bool is_classification;
+
+	vd getRawScores(vd&);
+	void addTreeScores(vvd&, vvd&, size_t);
+	vvd getProbabilities(vvd&);
+	double calculateLoss(vvd&, vd&);
+
+public:
+	boostedForest(vvd&, vvd&, vd&, int, double, int, int, bool, bool, treeOptions = treeOptions());
+	boostedForest(istream&);
+	double predict(vd&);
+	vd predict(vvd&);
+	void print(int);
+	double getStatsInfo(vd&, vd&, wstring);
+	int getNumRounds();
+	void save(ostream&);
+};
+
+#endif
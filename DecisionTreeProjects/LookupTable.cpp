@@ -0,0 +1,152 @@
+#include "LookupTable.h"
+
+// Constructor
+/*
+*  Constructors that compile a trained discrete tree or forest into a lookup table.
+*
+*  The features of the training data (the label column is skipped) only take a few distinct
+*  values each, so the model can be evaluated once for every combination of them ahead of
+*  time. Each combination is stored at its mixed-radix index: the code of a value is its
+*  position in the feature's sorted values and the index sums the codes times the strides
+*      index = code_0 * (n_1 * n_2 * ... ) + code_1 * (n_2 * ... ) + ... + code_last
+*  where n_y is the number of values of feature y. Prediction is then one table read whatever
+*  the size of the model.
+*
+*  The table is only built if the number of combinations is at most max_entries, otherwise
+*  (and for data points with a value never seen in training) predict walks the model instead.
+*  The model must outlive the table and must not be changed (e.g. pruned) after compiling.
+*/
+lookupTable::lookupTable(decisionTree& trained_tree, vvd& train_dataset, size_t max_entries)
+{
+	tree = &trained_tree;
+	forest = nullptr;
+	compile(train_dataset, max_entries);
+}
+
+lookupTable::lookupTable(randomForest& trained_forest, vvd& train_dataset, size_t max_entries)
+{
+	tree = nullptr;
+	forest = &trained_forest;
+	compile(train_dataset, max_entries);
+}
+
+// Private (Internal) Functions
+void lookupTable::compile(vvd& train_dataset, size_t max_entries)
+{
+	size_t num_features = train_dataset[0].size() - 1;
+	num_combinations = 1;
+	values.assign(num_features, vd());
+	for (size_t y = 0; y < num_features; y++) {
+		for (size_t x = 0; x < train_dataset.size(); x++) {
+			values[y].push_back(train_dataset[x][y]);
+		}
+		sort(values[y].begin(), values[y].end());
+		values[y].erase(unique(values[y].begin(), values[y].end()), values[y].end());
+		num_combinations *= values[y].size();
+	}
+	is_compiled = num_combinations <= max_entries;
+	if (!is_compiled) return;
+
+	strides.assign(num_features, 1);
+	for (size_t y = num_features - 1; y > 0; y--) {
+		strides[y - 1] = strides[y] * values[y].size();
+	}
+
+	// walk through the combinations in index order, counting up the codes like an odometer
+	// (the last feature changes fastest)
+	table.resize((size_t) num_combinations);
+	vector<size_t> codes(num_features, 0);
+	vd data_point(num_features);
+	for (size_t y = 0; y < num_features; y++) {
+		data_point[y] = values[y][0];
+	}
+	for (size_t idx = 0; idx < table.size(); idx++) {
+		table[idx] = walk(data_point);
+		for (size_t y = num_features; y > 0; y--) {
+			size_t& code = codes[y - 1];
+			code = (code + 1 == values[y - 1].size()) ? 0 : code + 1;
+			data_point[y - 1] = values[y - 1][code];
+			if (code != 0) break;
+		}
+	}
+}
+
+/*
+* Returns: - [double] the prediction of the compiled model itself
+*/
+double lookupTable::walk(vd& data)
+{
+	if (tree != nullptr) return tree->predict(data);
+
+	return forest->predict(data);
+}
+
+/*
+* Returns: - [long long] the position of the data point in the table, -1 if one of its values
+*            was not seen in training
+*/
+long long lookupTable::getIndex(vd& data)
+{
+	size_t idx = 0;
+
+	for (size_t y = 0; y < values.size(); y++) {
+		const vd& feature_values = values[y];
+		vd::const_iterator found = lower_bound(feature_values.begin(), feature_values.end(), data[y]);
+		if (found == feature_values.end() || *found != data[y]) return -1;
+		idx += (found - feature_values.begin()) * strides[y];
+	}
+
+	return idx;
+}
+
+// Public Functions
+/*
+* Returns: - [double] the predicted label for the input data, the same as the compiled model's
+*/
+double lookupTable::predict(vd& data)
+{
+	if (is_compiled) {
+		long long idx = getIndex(data);
+		if (idx != -1) return table[idx];
+	}
+
+	return walk(data);
+}
+
+/*
+* Overloaded version of predict that can handle sets of data.
+*
+* Returns: - [vd] the list of predicted labels for each data point in the dataset
+*/
+vd lookupTable::predict(vvd& dataset)
+{
+	vd predicted_labels;
+
+	for (size_t x = 0; x < dataset.size(); x++) {
+		predicted_labels.push_back(predict(dataset[x]));
+	}
+
+	return predicted_labels;
+}
+
+bool lookupTable::isCompiled()
+{
+	return is_compiled;
+}
+
+/*
+* Returns: - [size_t] the number of entries of the table, 0 if the model was not compiled
+*/
+size_t lookupTable::getSize()
+{
+	return table.size();
+}
+
+/*
+* Returns: - [double] the number of combinations of the feature values seen in training (as a
+*            double since it can overflow an integer when the model is not compiled)
+*/
+double lookupTable::getCombinationCount()
+{
+	return num_combinations;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef LOOKUP_TABLE_H_
+#define LOOKUP_TABLE_H_
+
+#include "DecisionTree.h"
+#include "RandomForest.h"
+
+// a trained discrete tree or forest compiled into a dense table of its predictions, with one
+// entry per combination of the feature values seen in training
+class lookupTable
+{
+	decisionTree* tree; // the compiled model, only one of the two is set
+	randomForest* forest;
+	vvd values; // the sorted distinct values of each feature, a value's position is its code
+	vector<size_t> strides; // place value of each feature's code in the mixed-radix table index
+	vd table;
+	double num_combinations;
+	bool is_compiled;
+
+	void compile(vvd&, size_t);
+	double walk(vd&);
+	long long getIndex(vd&);
+
+public:
+	lookupTable(decisionTree&, vvd&, size_t);
+	lookupTable(randomForest&, vvd&, size_t);
+	double predict(vd&);
+	vd predict(vvd&);
+	bool isCompiled();
+	size_t getSize();
+	double getCombinationCount();
+};
+
+#endif
@@ -1,44 +1,116 @@
 #include "RandomForest.h"
+#include "Scoring.h"
 
 // Constructor
 /*
 *  Creates forest of decision trees using bootstrapped datasets
+*
+*  Every tree draws its bootstrap sample and node samples from its own generator, seeded by 
+*  getTreeSeed from the master seed in options and the tree's position in the forest, so a 
+*  forest is reproducible for a given seed regardless of what else is running in the process.
 */
-randomForest::randomForest(vvd& dataset, int forest_size, int bag_size, bool discrete, bool classification)
+randomForest::randomForest(vvd& dataset, int forest_size, int bag_size, bool discrete, bool classification, treeOptions options)
+{
+    is_classification = classification;
+    first_tree = 0;
+
+    growTrees(dataset, 0, forest_size, bag_size, discrete, options);
+}
+
+/*
+*  Builds only the trees [tree_range.first, tree_range.second) of a forest, i.e. one shard of it. 
+*  Since every tree is seeded from the master seed and its index, the shards of a forest can be 
+*  trained in separate processes (or machines), saved, and merged back in order into exactly the 
+*  forest a single process would have built. The range is taken as a pair so that a call meant 
+*  for the full forest constructor cannot bind to this one through the int/bool conversions.
+*/
+randomForest::randomForest(vvd& dataset, pair<int,int> tree_range, int bag_size, bool discrete, bool classification, treeOptions options)
 {
-    int progress_cntr = 0;
     is_classification = classification;
+    first_tree = tree_range.first;
+
+    growTrees(dataset, tree_range.first, tree_range.second, bag_size, discrete, options);
+}
+
+/*
+*  Constructor that reads back a (possibly partial) forest written by save.
+*/
+randomForest::randomForest(istream& input)
+{
+    string tag;
+    size_t num_trees = 0;
+    bool is_weighted = false;
+    input >> tag >> is_classification >> first_tree >> num_trees >> is_weighted;
+    if (is_weighted) {
+        tree_weights.resize(num_trees);
+        for (size_t x = 0; x < num_trees; x++) {
+            input >> tree_weights[x];
+        }
+    }
+    if (!input || tag != "forest") {
+        wcout << L"ERROR: invalid forest model file, please check for errors" << endl;
+        exit(-1);
+    }
+
+    forest.reserve(num_trees);
+    for (size_t x = 0; x < num_trees; x++) {
+        forest.emplace_back(input);
+    }
+}
+
+// Private (Internal) Functions
+/*
+* Grows the trees [first, last) of the forest. The bootstrap samples are lists of row positions 
+* rather than copies of the rows, and all the trees are grown in one shared workspace (see 
+* treeWorkspace), so the dataset is only encoded once and the scratch buffers are reused from 
+* tree to tree. Without bootstrapping (e.g. for extremely randomized trees) every tree is 
+* trained on all the rows.
+*/
+void randomForest::growTrees(vvd& dataset, int first, int last, int bag_size, bool discrete, treeOptions options)
+{
+    int progress_cntr = 0;
+    int num_trees = last - first;
+    int data_cutoff = (options.min_data_size > 0) ? options.min_data_size : (int)sqrt(dataset.size());
 
-	for (int x = 0; x < forest_size; x++) {
-		vvd bootstrap_data = getBootstrapSample(dataset, bag_size);
-		decisionTree forest_tree(bootstrap_data, (int)sqrt(dataset.size()), discrete, classification, true);
-		forest.push_back(forest_tree);
+	treeWorkspace workspace;
+	vector<int> bootstrap_rows;
+	treeOptions tree_options = options;
+	tree_options.workspace = &workspace;
+	tree_options.sample_rows = options.bootstrap ? &bootstrap_rows : nullptr;
+	forest.reserve(num_trees);
+	for (int x = first; x < last; x++) {
+		minstd_rand tree_rng(getTreeSeed(options.seed, x));
+		if (options.bootstrap) getBootstrapSample(dataset.size(), bag_size, tree_rng, bootstrap_rows);
+		tree_options.seed = tree_rng();
+		forest.emplace_back(dataset, data_cutoff, discrete, is_classification, true, tree_options);
 
-        if (x == (progress_cntr * (forest_size / 20))) {
+        if (options.verbose && x - first == (progress_cntr * (num_trees / 20))) {
             wcout << L"Progress --- " << (progress_cntr * 5) << "%\n";
             progress_cntr++;
         }
 	}
 
-    wcout << L"Progress --- 100%\n";
+    if (options.verbose) wcout << L"Progress --- 100%\n";
 }
 
-// Private (Internal) Functions
-vvd randomForest::getBootstrapSample(vvd& input_data, int size)
+/*
+* Fills sample_rows with the positions of size rows drawn with replacement from the dataset.
+*/
+void randomForest::getBootstrapSample(int num_rows, int size, minstd_rand& tree_rng, vector<int>& sample_rows)
 {
-	vvd bootstrap_data;
+	sample_rows.clear();
 
     // redundant, but safety first! :)
-	if (input_data.size() < (size_t) size) {
-		bootstrap_data = input_data;
+	if (num_rows < size) {
+		for (int x = 0; x < num_rows; x++) {
+			sample_rows.push_back(x);
+		}
 	} else {
-		while (bootstrap_data.size() < (size_t) size) {
-			int rand_idx = rand() % input_data.size();
-			bootstrap_data.push_back(input_data[rand_idx]);
+		while (sample_rows.size() < (size_t) size) {
+			int rand_idx = tree_rng() % num_rows;
+			sample_rows.push_back(rand_idx);
 		}
 	}
-
-	return bootstrap_data;
 }
 
 void randomForest::printForestSample(int tree_idx)
@@ -47,32 +119,247 @@ void randomForest::printForestSample(int tree_idx)
 	return;
 }
 
-double randomForest::processStats(vd& test_labels, vd& test_predictions, wstring filename)
+/*
+* Returns: - [double] the number of misclassified rows, or the squared error for regression
+*/
+double randomForest::getValidationError(vvd& validation_data, vd& validation_labels)
 {
-	ofstream output_file;
-	output_file.open(filename);
-	int correct = 0;
+	double error = 0;
 
-	output_file << setw(2) << "#" << setw(10) << "True Label" << setw(30) << right << "Predicted Label\n";
-	output_file << "----------------------------------------------------------------" << endl;
-	for (size_t x = 0; x < test_labels.size(); x++) {
-		output_file << setw(2) << x + 1 << setw(10) << test_labels[x];
-		if (test_labels[x] == test_predictions[x]) {
-			correct++;
-			output_file << "            ";
+	for (size_t x = 0; x < validation_data.size(); x++) {
+		double diff = validation_labels[x] - predict(validation_data[x]);
+		if (is_classification) {
+			if (diff != 0) error++;
+		} else {
+			error += diff * diff;
 		}
-		else {
-			output_file << "  ********  ";
+	}
+
+	return error;
+}
+
+/*
+* Greedy ensemble selection: starting from an empty ensemble, the tree that lowers the error of 
+* the ensemble on the evaluation rows the most is added, until the ensemble's error is within 
+* tolerance of the full forest's (the misclassification rate, or the RMSE for regression) and 
+* every row the full forest votes on has a vote. A tree only votes on the rows that are not 
+* in_bag for it, and rows with no vote yet are given the most frequent (mean for regression) 
+* evaluation label. With weighted, a tree can be picked again (at most as many picks as trees), 
+* otherwise every tree is picked at most once. A tree's vote is its current weight (1 if the 
+* forest is unweighted), and each pick adds it again.
+*
+* The error of the ensemble on the rows its trees are picked on is biased towards the subset 
+* (the picked trees are those that happen to fit these rows best), so the number of picks is 
+* chosen by cross-validation instead: the rows are dealt into num_folds random folds (drawn from 
+* seed), and for every fold the selection is run on the other folds while the picked trees are 
+* scored on that fold. These runs go in lockstep, and the number of picks is the first at which 
+* their combined error on the held folds (every row being scored exactly once) is within 
+* tolerance of the full forest's error on all the rows. The trees are then picked on all the rows 
+* up to that number (or more, until the votes cover the rows the full forest votes on).
+*
+* The predictions of every tree are computed once up front and each row's votes are kept up to 
+* date, so trying a tree only costs one pass over its predictions. The forest keeps the picked 
+* trees in their original order, weighted by their number of picks (times their previous weight) 
+* if weighted or if the forest already had weights. The selected forest is no longer a range of 
+* trees of the full forest, so its first_tree is reset.
+*
+* Returns: - [double] the cross-validated error of the selection, full_error is set to the full 
+*            forest's error on the evaluation rows
+*/
+double randomForest::selectTrees(vvd& eval_data, vd& eval_labels, vector<vector<bool>>& in_bag, unsigned int seed, double tolerance, 
+	bool weighted, double& full_error)
+{
+	const int num_folds = 3;
+	size_t num_trees = forest.size();
+	size_t num_rows = eval_data.size();
+
+	// classification predictions are replaced by their position in the sorted labels, so that the 
+	// votes of a row fit in a small array and ties go to the smallest label as in predict
+	vvd tree_predictions(num_trees, vd(num_rows));
+	vd label_values(eval_labels);
+	for (size_t t = 0; t < num_trees; t++) {
+		for (size_t x = 0; x < num_rows; x++) {
+			tree_predictions[t][x] = forest[t].predict(eval_data[x]);
+			if (is_classification) label_values.push_back(tree_predictions[t][x]);
+		}
+	}
+	sort(label_values.begin(), label_values.end());
+	label_values.erase(unique(label_values.begin(), label_values.end()), label_values.end());
+	size_t num_labels = label_values.size();
+	vector<int> label_codes(num_rows);
+	vector<int> label_counts(num_labels, 0);
+	double prior = 0;
+	for (size_t x = 0; x < num_rows; x++) {
+		if (is_classification) {
+			label_codes[x] = lower_bound(label_values.begin(), label_values.end(), eval_labels[x]) - label_values.begin();
+			label_counts[label_codes[x]]++;
+			for (size_t t = 0; t < num_trees; t++) {
+				tree_predictions[t][x] = lower_bound(label_values.begin(), label_values.end(), tree_predictions[t][x]) - label_values.begin();
+			}
+		} else {
+			prior += eval_labels[x] / num_rows;
+		}
+	}
+	if (is_classification) prior = max_element(label_counts.begin(), label_counts.end()) - label_counts.begin();
+
+	// deal the rows into the folds: a random permutation, cut in num_folds slices
+	vector<int> row_folds(num_rows);
+	vector<int> row_order(num_rows);
+	iota(row_order.begin(), row_order.end(), 0);
+	minstd_rand fold_rng(seed);
+	for (size_t x = num_rows; x > 1; x--) {
+		swap(row_order[x - 1], row_order[fold_rng() % x]);
+	}
+	for (size_t x = 0; x < num_rows; x++) {
+		row_folds[row_order[x]] = x % num_folds;
+	}
+
+	// one greedy run: per row, the votes for each label code and the code winning them 
+	// (classification), or the weighted sum of the predictions and their weight (regression), and 
+	// the row's current error. The rows of held_fold (none if -1) are only scored, not picked on.
+	struct selectionState
+	{
+		vvd votes;
+		vector<int> best_codes;
+		vd row_errors;
+		vector<bool> is_covered;
+		int num_covered;
+		vector<int> picks;
+		int held_fold;
+		double check_total; // the total error (misclassified rows or squared error) on the held fold
+	};
+	int new_covered = 0; // the rows the last tree tried or added votes on first
+	auto getRowError = [&](size_t x, int best_code, double sum, double weight) {
+		if (is_classification) return (best_code == -1 ? (int) prior : best_code) == label_codes[x] ? 0.0 : 1.0;
+		double diff = eval_labels[x] - (weight > 0 ? sum / weight : prior);
+		return diff * diff;
+	};
+	auto resetState = [&](selectionState& state, int held_fold) {
+		state.votes.assign(num_rows, vd(is_classification ? num_labels : 2, 0));
+		state.best_codes.assign(num_rows, -1);
+		state.row_errors.resize(num_rows);
+		state.is_covered.assign(num_rows, false);
+		state.num_covered = 0;
+		state.picks.assign(num_trees, 0);
+		state.held_fold = held_fold;
+		state.check_total = 0;
+		for (size_t x = 0; x < num_rows; x++) {
+			state.row_errors[x] = getRowError(x, -1, 0, 0);
+			if (row_folds[x] == held_fold) state.check_total += state.row_errors[x];
+		}
+	};
+	// returns the ensemble's total error on the rows it is picked on if tree t was added with the 
+	// given weight, and adds it if apply
+	auto addTree = [&](selectionState& state, size_t t, double weight, bool apply) {
+		double total_error = 0;
+		if (apply) state.check_total = 0;
+		new_covered = 0;
+		for (size_t x = 0; x < num_rows; x++) {
+			double row_error = state.row_errors[x];
+			if (!in_bag[t][x]) {
+				if (!state.is_covered[x]) new_covered++;
+				vd& row_votes = state.votes[x];
+				int code = (int) tree_predictions[t][x];
+				int best_code = state.best_codes[x];
+				if (is_classification) {
+					double count = row_votes[code] + weight;
+					if (best_code == -1 || count > row_votes[best_code] || (count == row_votes[best_code] && code < best_code)) best_code = code;
+					row_error = getRowError(x, best_code, 0, 0);
+					if (apply) row_votes[code] = count;
+				} else {
+					row_error = getRowError(x, -1, row_votes[0] + weight * tree_predictions[t][x], row_votes[1] + weight);
+					if (apply) {
+						row_votes[0] += weight * tree_predictions[t][x];
+						row_votes[1] += weight;
+					}
+				}
+				if (apply) {
+					state.best_codes[x] = best_code;
+					state.row_errors[x] = row_error;
+					if (!state.is_covered[x]) state.num_covered++;
+					state.is_covered[x] = true;
+				}
+			}
+			if (row_folds[x] != state.held_fold) {
+				total_error += row_error;
+			} else if (apply) {
+				state.check_total += row_error;
+			}
+		}
+		return total_error;
+	};
+	auto getTreeWeight = [&](size_t t) {
+		return tree_weights.empty() ? 1.0 : tree_weights[t];
+	};
+	// adds the tree that lowers the error on the rows the state picks on the most
+	// NOTE: on equal errors the tree voting on more new rows wins, e.g. so that picking the same 
+	// tree again does not stall the coverage
+	auto pickTree = [&](selectionState& state) {
+		int best_tree = -1;
+		int best_covered = -1;
+		double best_error = numeric_limits<double>::infinity();
+		for (size_t t = 0; t < num_trees; t++) {
+			if (!weighted && state.picks[t] > 0) continue;
+			double candidate_error = addTree(state, t, getTreeWeight(t), false);
+			if (candidate_error < best_error || (candidate_error == best_error && new_covered > best_covered)) {
+				best_error = candidate_error;
+				best_covered = new_covered;
+				best_tree = t;
+			}
 		}
-		output_file << test_predictions[x] << endl;
+		addTree(state, best_tree, getTreeWeight(best_tree), true);
+		state.picks[best_tree]++;
+	};
+	auto getError = [&](double total_error, size_t count) {
+		if (count == 0) return 0.0;
+		return is_classification ? total_error / count : sqrt(total_error / count);
+	};
+
+	selectionState state;
+	resetState(state, -1);
+	for (size_t t = 0; t < num_trees; t++) {
+		addTree(state, t, getTreeWeight(t), true);
 	}
+	full_error = getError(accumulate(state.row_errors.begin(), state.row_errors.end(), 0.0), num_rows);
+	int full_covered = state.num_covered;
 
-	output_file << "----------------------------------------------------------------" << endl;
-	output_file << "Size of the test dataset: " << test_labels.size() << "\n";
-	output_file << "Number of correctly predicted labels: " << correct << endl;
-	output_file.close();
+	vector<selectionState> fold_states(num_folds);
+	double cv_total = 0;
+	for (int f = 0; f < num_folds; f++) {
+		resetState(fold_states[f], f);
+		cv_total += fold_states[f].check_total;
+	}
+	double cv_error = getError(cv_total, num_rows);
+	size_t num_picks = 0;
+	while (num_picks < num_trees && cv_error > full_error + tolerance) {
+		cv_total = 0;
+		for (int f = 0; f < num_folds; f++) {
+			pickTree(fold_states[f]);
+			cv_total += fold_states[f].check_total;
+		}
+		num_picks++;
+		cv_error = getError(cv_total, num_rows);
+	}
 
-	return (double) correct / test_labels.size();
+	resetState(state, -1);
+	for (size_t pick = 0; pick < num_trees && (pick < num_picks || state.num_covered < full_covered); pick++) {
+		pickTree(state);
+	}
+
+	vector<decisionTree> selected_forest;
+	vd selected_weights;
+	for (size_t t = 0; t < num_trees; t++) {
+		if (state.picks[t] == 0) continue;
+		selected_forest.push_back(move(forest[t]));
+		selected_weights.push_back(state.picks[t] * getTreeWeight(t));
+	}
+	forest = move(selected_forest);
+	first_tree = 0;
+	if (weighted || !tree_weights.empty()) {
+		tree_weights = selected_weights;
+	}
+
+	return cv_error;
 }
 
 // Public Functions
@@ -81,36 +368,34 @@ double randomForest::processStats(vd& test_labels, vd& test_predictions, wstring
 */
 double randomForest::predict(vd& data)
 {
-	double label;
-	map<double,int> predictions;
+	double label = 0;
+	map<double,double> predictions;
     double total_prediction = 0;
+    double total_weight = 0;
 	
 	for (size_t x = 0; x < forest.size(); x++) {
 		double prediction = forest[x].predict(data);
+		double weight = tree_weights.empty() ? 1 : tree_weights[x];
         if (is_classification) {
-            if (predictions.count(prediction) == 0) {
-                predictions[prediction] = 1;
-            }
-            else {
-                predictions[prediction]++;
-            }
+            predictions[prediction] += weight;
         } else {
-            total_prediction += prediction;
+            total_prediction += weight * prediction;
+            total_weight += weight;
         }
 	}
 
     if (is_classification) {
-        int max_count = -1;
+        double max_count = -1;
         // NOTE: ties are broken "randomly" (i.e. first visited is chosen)
-        for (map<double, int>::iterator itr = predictions.begin(); itr != predictions.end(); ++itr) {
-            int label_count = itr->second;
+        for (map<double, double>::iterator itr = predictions.begin(); itr != predictions.end(); ++itr) {
+            double label_count = itr->second;
             if (label_count > max_count) {
                 label = itr->first;
                 max_count = label_count;
             }
         }
     } else {
-        label = total_prediction / forest.size();
+        label = total_prediction / total_weight;
     }
 
 	return label;
@@ -136,8 +421,9 @@ void randomForest::print(int sample_size)
 {
 	wcout << L"Taking Sample of Size " << sample_size << " from the Forest:\n";
 	wcout << L"----------------------------------------------------------------" << endl;
-	int step_size = (int) floor(forest.size() / (double) sample_size);
-	for (int x = 0; x < forest.size(); x += step_size) {
+	// NOTE: at least 1, a selected forest (see selectTrees) can have fewer trees than the sample
+	int step_size = max(1, (int) floor(forest.size() / (double) sample_size));
+	for (size_t x = 0; x < forest.size(); x += step_size) {
 		wcout << L"Random Forest: Tree " << x << "\n";
 		printForestSample(x);
 		wcout << endl;
@@ -147,9 +433,193 @@ void randomForest::print(int sample_size)
 double randomForest::getStatsInfo(vd& test_labels, vd& test_predictions, wstring filename)
 {
 	wcout << L"Statistics:\n";
-	double accuracy = processStats(test_labels, test_predictions, filename);
+	statsAccumulator stats = writeStatsReport(test_labels, test_predictions, filename, is_classification);
 	wcout << L"NOTE: testing results recorded at " << filename << "\n";
-	wcout << L"\nModel Accuracy on Test Data: " << accuracy << endl;
+	stats.print();
+
+	return stats.getAccuracy();
+}
 
-	return accuracy;
-}
\ No newline at end of file
+/*
+* Prunes every tree of the forest with the same cost-complexity alpha.
+*/
+void randomForest::costComplexityPrune(double alpha)
+{
+	for (size_t x = 0; x < forest.size(); x++) {
+		forest[x].costComplexityPrune(alpha);
+	}
+}
+
+/*
+* Each tree has its own pruning path, so the forest's alpha is picked from a fixed grid by the 
+* validation error of the whole pruned forest, preferring the larger alpha on ties. The forest 
+* itself is left unpruned.
+*
+* Returns: - [double] the selected alpha
+*/
+double randomForest::selectPruningAlpha(vvd& validation_data, vd& validation_labels)
+{
+	double candidates[] = { 0, 0.0005, 0.001, 0.002, 0.005, 0.01, 0.02, 0.05 };
+	vector<decisionTree> full_forest = forest;
+	double best_alpha = 0;
+	double best_error = numeric_limits<double>::infinity();
+
+	for (double alpha : candidates) {
+		forest = full_forest;
+		costComplexityPrune(alpha);
+		double error = getValidationError(validation_data, validation_labels);
+		if (error <= best_error) {
+			best_error = error;
+			best_alpha = alpha;
+		}
+	}
+	forest = full_forest;
+
+	return best_alpha;
+}
+
+/*
+* Applies reduced-error pruning to every tree of the forest against the same validation data.
+*/
+void randomForest::reducedErrorPrune(vvd& validation_data, vd& validation_labels)
+{
+	for (size_t x = 0; x < forest.size(); x++) {
+		forest[x].reducedErrorPrune(validation_data, validation_labels);
+	}
+}
+
+/*
+* Selects a subset of the trees (see the private selectTrees) that is about as accurate on the 
+* validation data as the whole forest, the seed deals the validation rows into the folds.
+*
+* Returns: - [double] the cross-validated validation error of the selection (misclassification 
+*            rate, or RMSE for regression), full_error is set to the full forest's
+*/
+double randomForest::selectTrees(vvd& validation_data, vd& validation_labels, unsigned int seed, double tolerance, bool weighted, 
+	double& full_error)
+{
+	vector<vector<bool>> in_bag(forest.size(), vector<bool>(validation_data.size(), false));
+
+	return selectTrees(validation_data, validation_labels, in_bag, seed, tolerance, weighted, full_error);
+}
+
+/*
+* Selects a subset of the trees (see the private selectTrees) that is about as accurate as the 
+* whole forest out of bag, i.e. every training row is only voted on by the trees whose bootstrap 
+* sample left it out. The bootstrap samples are not stored, they are drawn again from each tree's 
+* seed, so the dataset, bag size and master seed must be those the forest was trained with (the 
+* master seed also deals the rows into the folds).
+*
+* Returns: - [double] the cross-validated out-of-bag error of the selection (misclassification 
+*            rate, or RMSE for regression), full_error is set to the full forest's
+*/
+double randomForest::selectTreesOutOfBag(vvd& train_dataset, int bag_size, unsigned int seed, double tolerance, bool weighted, 
+	double& full_error)
+{
+	vector<vector<bool>> in_bag(forest.size(), vector<bool>(train_dataset.size(), false));
+	vector<int> bootstrap_rows;
+	for (size_t x = 0; x < forest.size(); x++) {
+		minstd_rand tree_rng(getTreeSeed(seed, first_tree + x));
+		getBootstrapSample(train_dataset.size(), bag_size, tree_rng, bootstrap_rows);
+		for (size_t r = 0; r < bootstrap_rows.size(); r++) {
+			in_bag[x][bootstrap_rows[r]] = true;
+		}
+	}
+
+	size_t label_idx = train_dataset[0].size() - 1;
+	vd train_labels(train_dataset.size());
+	for (size_t x = 0; x < train_dataset.size(); x++) {
+		train_labels[x] = train_dataset[x][label_idx];
+	}
+
+	return selectTrees(train_dataset, train_labels, in_bag, seed, tolerance, weighted, full_error);
+}
+
+int randomForest::getTreeCount()
+{
+	return forest.size();
+}
+
+int randomForest::getNodeCount()
+{
+	int count = 0;
+	for (size_t x = 0; x < forest.size(); x++) {
+		count += forest[x].getNodeCount();
+	}
+
+	return count;
+}
+
+int randomForest::getLeafCount()
+{
+	int count = 0;
+	for (size_t x = 0; x < forest.size(); x++) {
+		count += forest[x].getLeafCount();
+	}
+
+	return count;
+}
+
+/*
+* Returns: - [int] the depth of the deepest tree in the forest
+*/
+int randomForest::getDepth()
+{
+	int depth = 0;
+	for (size_t x = 0; x < forest.size(); x++) {
+		depth = max(depth, forest[x].getDepth());
+	}
+
+	return depth;
+}
+
+/*
+* Writes the forest as text: a "forest <classification> <first tree> <tree count> <weighted>" line, 
+* the tree weights on one line if it has any, and every tree (see decisionTree::save).
+*/
+void randomForest::save(ostream& output)
+{
+	output << "forest " << is_classification << " " << first_tree << " " << forest.size() << " " << !tree_weights.empty() << "\n";
+	if (!tree_weights.empty()) {
+		for (size_t x = 0; x < tree_weights.size(); x++) {
+			output << (x > 0 ? " " : "") << tree_weights[x];
+		}
+		output << "\n";
+	}
+	for (size_t x = 0; x < forest.size(); x++) {
+		forest[x].save(output);
+	}
+}
+
+/*
+* Appends the trees of shard, which must be the range of trees that directly follows this 
+* forest's, e.g. when merging the partial forests of a sharded training run in order.
+*/
+void randomForest::merge(randomForest& shard)
+{
+	if (shard.first_tree != first_tree + (int) forest.size() || shard.is_classification != is_classification 
+		|| !tree_weights.empty() || !shard.tree_weights.empty()) {
+		wcout << L"ERROR: forest shards do not line up, please check for errors" << endl;
+		exit(-1);
+	}
+
+	forest.reserve(forest.size() + shard.forest.size());
+	for (size_t x = 0; x < shard.forest.size(); x++) {
+		forest.push_back(move(shard.forest[x]));
+	}
+	shard.forest.clear();
+}
+
+/*
+* Derives the seed of a single tree from the master seed of the forest and the tree's index.
+*
+* Returns: - [unsigned int] the seed for the tree at tree_idx
+*/
+unsigned int randomForest::getTreeSeed(unsigned int master_seed, int tree_idx)
+{
+	seed_seq seq{ master_seed, (unsigned int) tree_idx };
+	unsigned int tree_seed;
+	seq.generate(&tree_seed, &tree_seed + 1);
+
+	return tree_seed;
+}
@@ -4,22 +4,44 @@
 #define DECISION_FOREST_H_
 
 #include "DecisionTree.h"
+#include <numeric>
 
 class randomForest
 {
 	vector<decisionTree> forest;
     bool is_classification;
+	int first_tree; // index of the first tree in the full forest (non-zero for a shard, see the range constructor, zero once trees are selected)
+	vd tree_weights; // vote of every tree, empty when every tree counts once (see selectTrees)
 
-	vvd getBootstrapSample(vvd&, int);
+	void growTrees(vvd&, int, int, int, bool, treeOptions);
+	void getBootstrapSample(int, int, minstd_rand&, vector<int>&);
 	void printForestSample(int);
-	double processStats(vd&, vd&, wstring);
+	double getValidationError(vvd&, vd&);
+	double selectTrees(vvd&, vd&, vector<vector<bool>>&, unsigned int, double, bool, double&);
+
+	friend class compactForest;
+	friend class treeExplainer;
 
 public:
-	randomForest(vvd&, int, int, bool, bool);
+	randomForest(vvd&, int, int, bool, bool, treeOptions = treeOptions());
+	randomForest(vvd&, pair<int,int>, int, bool, bool, treeOptions = treeOptions());
+	randomForest(istream&);
 	double predict(vd&);
 	vd predict(vvd&);
 	void print(int);
 	double getStatsInfo(vd&, vd&, wstring);
+	void costComplexityPrune(double);
+	double selectPruningAlpha(vvd&, vd&);
+	void reducedErrorPrune(vvd&, vd&);
+	double selectTrees(vvd&, vd&, unsigned int, double, bool, double&);
+	double selectTreesOutOfBag(vvd&, int, unsigned int, double, bool, double&);
+	int getTreeCount();
+	int getNodeCount();
+	int getLeafCount();
+	int getDepth();
+	void save(ostream&);
+	void merge(randomForest&);
+	static unsigned int getTreeSeed(unsigned int, int);
 };
 
 #endif
\ No newline at end of file
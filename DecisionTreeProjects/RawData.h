@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef RAW_DATA_H_
+#define RAW_DATA_H_
+
+#include "DecisionTree.h"
+#include <cstdint>
+
+// read-only memory mapping of a whole file, unmapped when it goes out of scope
+class mappedFile
+{
+	const char* data;
+	size_t size;
+	// NOTE: the platform handles are kept opaque so that the system headers stay out of this one, 
+	//       they hold the file and mapping HANDLEs on Windows, and the file descriptor elsewhere
+	intptr_t file_handle;
+	intptr_t mapping_handle;
+
+public:
+	mappedFile(string);
+	~mappedFile();
+	mappedFile(const mappedFile&) = delete;
+	mappedFile& operator=(const mappedFile&) = delete;
+	const char* begin();
+	const char* end();
+	size_t getSize();
+};
+
+// a dataset stored one column per attribute, with the source file of every row
+struct columnarData
+{
+	vector<int> attributes; // the attribute number (1-based, as in the UCI documentation) of each column
+	vvd columns;
+	vector<int> row_sources; // position in source_names of the file each row came from
+	vector<string> source_names;
+	vector<size_t> source_rows; // number of records read from each source
+	vector<size_t> source_skipped; // number of malformed (or incomplete, see parseRawData) records skipped per source
+	size_t num_rows = 0;
+	size_t num_bytes = 0; // size of all the sources
+};
+
+const int raw_attribute_count = 76; // the attributes of a raw record, the last one is the "name" placeholder
+const double raw_missing_value = -9;
+
+columnarData parseRawData(vector<string>&, vector<int>&, bool);
+vvd getRows(columnarData&);
+vector<int> parseAttributeList(string);
+
+#endif
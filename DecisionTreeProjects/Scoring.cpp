@@ -0,0 +1,166 @@
+#include "Scoring.h"
+
+// Constructor
+statsAccumulator::statsAccumulator(bool classification)
+{
+	is_classification = classification;
+	count = 0;
+	correct = 0;
+	abs_error = 0;
+	sq_error = 0;
+}
+
+// Public Functions
+void statsAccumulator::add(double label, double prediction)
+{
+	double diff = label - prediction;
+
+	count++;
+	if (diff == 0) correct++;
+	abs_error += fabs(diff);
+	sq_error += diff * diff;
+	if (is_classification) confusion[label][prediction]++;
+}
+
+long long statsAccumulator::getCount()
+{
+	return count;
+}
+
+long long statsAccumulator::getCorrect()
+{
+	return correct;
+}
+
+double statsAccumulator::getAccuracy()
+{
+	return (double) correct / count;
+}
+
+double statsAccumulator::getMAE()
+{
+	return abs_error / count;
+}
+
+double statsAccumulator::getRMSE()
+{
+	return sqrt(sq_error / count);
+}
+
+/*
+* Writes the summary at the end of a testing results file: the number of (correctly) predicted 
+* rows, then the confusion matrix (rows are true labels, columns predicted labels) for 
+* classification or the MAE and RMSE for regression.
+*/
+void statsAccumulator::write(ostream& output)
+{
+	output << "Size of the test dataset: " << count << "\n";
+	output << "Number of correctly predicted labels: " << correct << "\n";
+	if (!is_classification) {
+		output << "Mean absolute error: " << getMAE() << "\n";
+		output << "Root mean squared error: " << getRMSE() << "\n";
+		return;
+	}
+
+	vd columns;
+	for (map<double, map<double, long long>>::iterator itr = confusion.begin(); itr != confusion.end(); ++itr) {
+		for (map<double, long long>::iterator col = itr->second.begin(); col != itr->second.end(); ++col) {
+			columns.push_back(col->first);
+		}
+	}
+	sort(columns.begin(), columns.end());
+	columns.erase(unique(columns.begin(), columns.end()), columns.end());
+
+	output << "\nConfusion Matrix (rows: true label, columns: predicted label):\n";
+	output << setw(10) << "";
+	for (size_t y = 0; y < columns.size(); y++) {
+		output << setw(10) << columns[y];
+	}
+	output << "\n";
+	for (map<double, map<double, long long>>::iterator itr = confusion.begin(); itr != confusion.end(); ++itr) {
+		output << setw(10) << itr->first;
+		for (size_t y = 0; y < columns.size(); y++) {
+			map<double, long long>::iterator cell = itr->second.find(columns[y]);
+			output << setw(10) << ((cell == itr->second.end()) ? 0 : cell->second);
+		}
+		output << "\n";
+	}
+}
+
+void statsAccumulator::print()
+{
+	wcout << L"\nModel Accuracy on Test Data: " << getAccuracy() << "\n";
+	if (!is_classification) {
+		wcout << L"Mean Absolute Error on Test Data: " << getMAE() << "\n";
+		wcout << L"Root Mean Squared Error on Test Data: " << getRMSE() << "\n";
+	}
+	wcout << flush;
+}
+
+// Constructor
+/*
+*  Opens the testing results file and writes its header. The file gets a large buffer and rows 
+*  end with '\n' rather than endl, so it is only flushed when the buffer is full.
+*/
+statsReport::statsReport(wstring filename, bool classification) : stats(classification)
+{
+	buffer.resize(1 << 20);
+	output_file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+#ifdef _WIN32
+	output_file.open(filename);
+#else
+	// NOTE: opening a stream with a wide path is an MSVC extension, the names used here are ASCII
+	output_file.open(string(filename.begin(), filename.end()));
+#endif
+	if (!output_file) {
+		wcerr << L"Error: could not open the testing results file " << filename << endl;
+		exit(-1);
+	}
+
+	output_file << setw(2) << "#" << setw(10) << "True Label" << setw(30) << right << "Predicted Label\n";
+	output_file << "----------------------------------------------------------------\n";
+}
+
+// Public Functions
+void statsReport::add(double label, double prediction)
+{
+	stats.add(label, prediction);
+	output_file << setw(2) << stats.getCount() << setw(10) << label;
+	if (label == prediction) {
+		output_file << "            ";
+	}
+	else {
+		output_file << "  ********  ";
+	}
+	output_file << prediction << "\n";
+}
+
+/*
+* Writes the summary and closes the file.
+*
+* Returns: - [statsAccumulator&] the metrics of all the rows added
+*/
+statsAccumulator& statsReport::finish()
+{
+	output_file << "----------------------------------------------------------------\n";
+	stats.write(output_file);
+	output_file.close();
+
+	return stats;
+}
+
+/*
+* Writes the testing results file for a whole set of predictions at once.
+*
+* Returns: - [statsAccumulator] the metrics of the predictions
+*/
+statsAccumulator writeStatsReport(vd& test_labels, vd& test_predictions, wstring filename, bool classification)
+{
+	statsReport report(filename, classification);
+
+	for (size_t x = 0; x < test_labels.size(); x++) {
+		report.add(test_labels[x], test_predictions[x]);
+	}
+
+	return report.finish();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef SCORING_H_
+#define SCORING_H_
+
+#include "DecisionTree.h"
+
+// single-pass test metrics, the memory used only grows with the number of distinct labels
+class statsAccumulator
+{
+	bool is_classification;
+	long long count;
+	long long correct;
+	double abs_error;
+	double sq_error;
+	map<double, map<double, long long>> confusion; // true label -> predicted label -> count
+
+public:
+	statsAccumulator(bool);
+	void add(double, double);
+	long long getCount();
+	long long getCorrect();
+	double getAccuracy();
+	double getMAE();
+	double getRMSE();
+	void write(ostream&);
+	void print();
+};
+
+// the per-row testing results file shared by the trees and forests, written row by row
+class statsReport
+{
+	vector<char> buffer; // declared first so it outlives the stream that writes into it
+	ofstream output_file;
+	statsAccumulator stats;
+
+public:
+	statsReport(wstring, bool);
+	void add(double, double);
+	statsAccumulator& finish();
+};
+
+statsAccumulator writeStatsReport(vd&, vd&, wstring, bool);
+
+#endif
@@ -0,0 +1,64 @@
+#include "SparseData.h"
+
+/*
+* Returns: - [double] the value at (row, col), zero if it is not stored
+*/
+double getSparseValue(csrMatrix& sparse_data, int row, int col)
+{
+	vector<int>::iterator first = sparse_data.col_idx.begin() + sparse_data.row_ptr[row];
+	vector<int>::iterator last = sparse_data.col_idx.begin() + sparse_data.row_ptr[row + 1];
+	vector<int>::iterator pos = lower_bound(first, last, col);
+	if (pos == last || *pos != col) return 0;
+
+	return sparse_data.values[pos - sparse_data.col_idx.begin()];
+}
+
+/*
+* Parses a sparse data file with one data point per line in the form
+*   label col:value col:value ...
+* where the column indices are 0-based (matching the columns of the dense csv files) and 
+* columns that are not listed are zero.
+*
+* Returns: - [tuple<csrMatrix, vd>] the feature matrix and the labels
+*/
+tuple<csrMatrix, vd> parseSparseData(string data_file)
+{
+	csrMatrix sparse_data;
+	vd labels;
+	ifstream input_file;
+	string data_string;
+
+	input_file.open(data_file);
+	if (!input_file) {
+		wcerr << L"Error: Invalid path to sparse data file" << endl;
+		exit(-1);
+	}
+	sparse_data.row_ptr.push_back(0);
+	while (getline(input_file, data_string)) {
+		if (data_string.find_first_not_of(" \t\r") == string::npos) continue;
+		const char* pos = data_string.c_str();
+		char* end;
+		labels.push_back(strtod(pos, &end));
+		pos = end;
+
+		vector<pair<int,double>> row;
+		while (true) {
+			long col = strtol(pos, &end, 10);
+			if (end == pos || *end != ':') break;
+			pos = end + 1;
+			double val = strtod(pos, &end);
+			pos = end;
+			if (val != 0) row.push_back(make_pair((int) col, val));
+		}
+		sort(row.begin(), row.end());
+		for (size_t k = 0; k < row.size(); k++) {
+			sparse_data.col_idx.push_back(row[k].first);
+			sparse_data.values.push_back(row[k].second);
+			sparse_data.num_cols = max(sparse_data.num_cols, row[k].first + 1);
+		}
+		sparse_data.row_ptr.push_back(sparse_data.col_idx.size());
+		sparse_data.num_rows++;
+	}
+
+	return make_tuple(sparse_data, labels);
+}
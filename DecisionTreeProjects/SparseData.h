@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef SPARSE_DATA_H_
+#define SPARSE_DATA_H_
+
+#include "DecisionTree.h"
+
+// compressed sparse row matrix, one row per data point with the column indices of each row sorted
+struct csrMatrix
+{
+	int num_rows = 0;
+	int num_cols = 0;
+	vector<size_t> row_ptr; // row x occupies [row_ptr[x], row_ptr[x + 1]) of col_idx and values
+	vector<int> col_idx;
+	vd values;
+};
+
+// everything the sparse tree builder shares between nodes, allocated once per tree
+struct sparseContext
+{
+	csrMatrix* data; // the training rows, every node gathers its non-zeros from its own rows
+	vd labels;
+	vd class_values; // classification only, the distinct labels in order
+	vector<int> row_classes; // classification only, the position of each row's label in class_values
+	vector<size_t> col_counts; // non-zeros of each column within the node being split, zero for the other columns
+	vector<int> node_cols; // the columns with at least one non-zero within the node being split
+	vector<pair<double,int>> entries; // the non-zero (value, row) entries of the node, bucketed by column
+	vector<int> rows; // the training rows, partitioned in place so every node owns a contiguous range
+	vector<int> row_buffer; // scratch for the partitions
+	vd node_stats; // label counts (or count, sum and squared sum) of the node being split
+	vd nonzero_stats;
+	vd left_stats;
+	vd right_stats;
+};
+
+double getSparseValue(csrMatrix&, int, int);
+tuple<csrMatrix, vd> parseSparseData(string);
+
+#endif
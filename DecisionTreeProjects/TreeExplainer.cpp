@@ -0,0 +1,313 @@
+#include "TreeExplainer.h"
+
+// Constructor
+/*
+*  Constructors that explain the predictions of a trained tree or forest with SHAP values.
+*
+*  The SHAP value of a feature is its average contribution to the prediction over all the 
+*  orders in which the features can be revealed, where the output for a subset of known 
+*  features follows those features' splits and averages over both sides of the other splits, 
+*  weighted by the share of the training data (the node frequencies) that went each way. 
+*  TreeSHAP computes them exactly in a single walk of each tree, O(L * D^2) for a tree with L 
+*  leaves and depth D, instead of trying the exponentially many subsets. The values plus the 
+*  expected output over the training data add up to the explained output: the prediction for 
+*  regression, or the share of the (weighted) tree votes for the predicted label for 
+*  classification, so for a single tree the output is 1.
+*
+*  The model must outlive the explainer and must not be changed (e.g. pruned) afterwards.
+*/
+treeExplainer::treeExplainer(decisionTree& trained_tree)
+{
+	is_classification = trained_tree.is_classification;
+	trees.push_back(&trained_tree);
+	tree_weights.push_back(1);
+	prepare();
+}
+
+treeExplainer::treeExplainer(randomForest& trained_forest)
+{
+	is_classification = trained_forest.is_classification;
+	for (size_t x = 0; x < trained_forest.forest.size(); x++) {
+		trees.push_back(&trained_forest.forest[x]);
+		tree_weights.push_back(trained_forest.tree_weights.empty() ? 1 : trained_forest.tree_weights[x]);
+	}
+	prepare();
+}
+
+// Private (Internal) Functions
+/*
+* Collects the labels of the leaves, the expected output of every tree and the path space needed.
+*/
+void treeExplainer::prepare()
+{
+	total_weight = 0;
+	int max_depth = 0;
+	for (size_t t = 0; t < trees.size(); t++) {
+		total_weight += tree_weights[t];
+		max_depth = max(max_depth, trees[t]->getDepth());
+		if (!is_classification) continue;
+		for (size_t x = 0; x < trees[t]->nodes.size(); x++) {
+			class_values.push_back(trees[t]->nodes[x].label);
+		}
+	}
+	sort(class_values.begin(), class_values.end());
+	class_values.erase(unique(class_values.begin(), class_values.end()), class_values.end());
+
+	expected_values.assign(trees.size(), vd());
+	for (size_t t = 0; t < trees.size(); t++) {
+		if (is_classification) {
+			for (size_t c = 0; c < class_values.size(); c++) {
+				expected_values[t].push_back(getExpectedValue(*trees[t], 0, class_values[c]));
+			}
+		} else {
+			expected_values[t].push_back(getExpectedValue(*trees[t], 0, 0));
+		}
+	}
+
+	// every level of the recursion keeps its own copy of the path, which has at most depth + 2 
+	// elements (the root's placeholder, one per split and one spare while extending)
+	path_size = (size_t) (max_depth + 2) * (max_depth + 3) / 2 + 1;
+}
+
+/*
+* Returns: - [double] the output of the subtree at node_idx averaged over the training data, i.e. 
+*            with the children weighted by their frequency; for classification the output is 1 
+*            when the leaf predicts class_label, else 0
+*/
+double treeExplainer::getExpectedValue(decisionTree& tree, int node_idx, double class_label)
+{
+	const node& node_ref = tree.nodes[node_idx];
+	if (node_ref.is_leaf) {
+		if (is_classification) return (node_ref.label == class_label) ? 1 : 0;
+		return node_ref.label;
+	}
+
+	double total_frequency = 0;
+	double expected_value = 0;
+	for (int x = 0; x < node_ref.num_children; x++) {
+		const node& child = tree.nodes[node_ref.first_child + x];
+		total_frequency += child.frequency;
+		expected_value += child.frequency * getExpectedValue(tree, node_ref.first_child + x, class_label);
+	}
+
+	return (total_frequency > 0) ? expected_value / total_frequency : 0;
+}
+
+/*
+* Adds scale times the SHAP values of the subtree at node_idx for the data point to phi 
+* (Algorithm 2 of Lundberg et al., "Consistent Individualized Feature Attribution for Tree 
+* Ensembles"). The path holds the distinct features split on above the node; the parent's copy 
+* is extended by the node's feature into the next free space of the buffer, so each level of the 
+* recursion owns its copy. A feature split on twice is first unwound from the path and 
+* re-added with the combined fractions. Unlike binary trees, a node can have any number of 
+* children (multiway splits), each one followed with its share of the node's frequency.
+*/
+void treeExplainer::explainTree(decisionTree& tree, int node_idx, vd& data, double class_label, double scale, vd& phi, 
+	shapPathElement* parent_path, int unique_depth, double zero_fraction, double one_fraction, int feature)
+{
+	shapPathElement* path = parent_path + unique_depth + 1;
+	copy(parent_path, parent_path + unique_depth + 1, path);
+	extendPath(path, unique_depth, zero_fraction, one_fraction, feature);
+
+	const node& node_ref = tree.nodes[node_idx];
+	if (node_ref.is_leaf) {
+		double leaf_value = node_ref.label;
+		if (is_classification) leaf_value = (node_ref.label == class_label) ? 1 : 0;
+		if (leaf_value == 0) return;
+		for (int x = 1; x <= unique_depth; x++) {
+			double weight = getUnwoundPathSum(path, unique_depth, x);
+			phi[path[x].feature] += scale * weight * (path[x].one_fraction - path[x].zero_fraction) * leaf_value;
+		}
+		return;
+	}
+
+	int hot_child = tree.selectChild(node_ref, data);
+	double incoming_zero_fraction = 1;
+	double incoming_one_fraction = 1;
+	int path_idx = 0;
+	while (path_idx <= unique_depth && path[path_idx].feature != node_ref.split_var) {
+		path_idx++;
+	}
+	if (path_idx <= unique_depth) {
+		incoming_zero_fraction = path[path_idx].zero_fraction;
+		incoming_one_fraction = path[path_idx].one_fraction;
+		unwindPath(path, unique_depth, path_idx);
+		unique_depth--;
+	}
+
+	double total_frequency = 0;
+	for (int x = 0; x < node_ref.num_children; x++) {
+		total_frequency += tree.nodes[node_ref.first_child + x].frequency;
+	}
+	for (int x = 0; x < node_ref.num_children; x++) {
+		double child_zero_fraction = incoming_zero_fraction * tree.nodes[node_ref.first_child + x].frequency / total_frequency;
+		double child_one_fraction = (x == hot_child) ? incoming_one_fraction : 0;
+		// NOTE: a child no data went to and the point does not reach adds nothing (and cannot be unwound)
+		if (child_zero_fraction == 0 && child_one_fraction == 0) continue;
+		explainTree(tree, node_ref.first_child + x, data, class_label, scale, phi, path, unique_depth + 1, 
+			child_zero_fraction, child_one_fraction, node_ref.split_var);
+	}
+}
+
+/*
+* Fills phi with the SHAP value of every feature of the data point, followed by the expected 
+* output (the values add up to the explained output), using path as scratch space.
+*/
+void treeExplainer::explainRow(vd& data, vd& phi, vector<shapPathElement>& path)
+{
+	phi.assign(data.size() + 1, 0);
+	double class_label = 0;
+	getExplainedValue(data, class_label);
+	size_t class_idx = lower_bound(class_values.begin(), class_values.end(), class_label) - class_values.begin();
+
+	double expected_value = 0;
+	for (size_t t = 0; t < trees.size(); t++) {
+		double scale = tree_weights[t] / total_weight;
+		explainTree(*trees[t], 0, data, class_label, scale, phi, path.data(), 0, 1, 1, -1);
+		expected_value += scale * expected_values[t][is_classification ? class_idx : 0];
+	}
+	phi[data.size()] = expected_value;
+}
+
+/*
+* Adds the feature to the end of the path (at unique_depth), updating the weights of the subsets 
+* of every size.
+*/
+void treeExplainer::extendPath(shapPathElement* path, int unique_depth, double zero_fraction, double one_fraction, int feature)
+{
+	path[unique_depth].feature = feature;
+	path[unique_depth].zero_fraction = zero_fraction;
+	path[unique_depth].one_fraction = one_fraction;
+	path[unique_depth].weight = (unique_depth == 0) ? 1 : 0;
+
+	for (int x = unique_depth - 1; x >= 0; x--) {
+		path[x + 1].weight += one_fraction * path[x].weight * (x + 1) / (unique_depth + 1);
+		path[x].weight = zero_fraction * path[x].weight * (unique_depth - x) / (unique_depth + 1);
+	}
+}
+
+/*
+* Removes the element at path_idx from the path, undoing its extendPath.
+*/
+void treeExplainer::unwindPath(shapPathElement* path, int unique_depth, int path_idx)
+{
+	double one_fraction = path[path_idx].one_fraction;
+	double zero_fraction = path[path_idx].zero_fraction;
+	double next_one_portion = path[unique_depth].weight;
+
+	for (int x = unique_depth - 1; x >= 0; x--) {
+		if (one_fraction != 0) {
+			double weight = path[x].weight;
+			path[x].weight = next_one_portion * (unique_depth + 1) / ((x + 1) * one_fraction);
+			next_one_portion = weight - path[x].weight * zero_fraction * (unique_depth - x) / (unique_depth + 1);
+		} else {
+			path[x].weight = path[x].weight * (unique_depth + 1) / (zero_fraction * (unique_depth - x));
+		}
+	}
+
+	for (int x = path_idx; x < unique_depth; x++) {
+		path[x].feature = path[x + 1].feature;
+		path[x].zero_fraction = path[x + 1].zero_fraction;
+		path[x].one_fraction = path[x + 1].one_fraction;
+	}
+}
+
+/*
+* Returns: - [double] the total weight of the path if the element at path_idx was unwound, 
+*            without changing the path
+*/
+double treeExplainer::getUnwoundPathSum(shapPathElement* path, int unique_depth, int path_idx)
+{
+	double one_fraction = path[path_idx].one_fraction;
+	double zero_fraction = path[path_idx].zero_fraction;
+	double next_one_portion = path[unique_depth].weight;
+	double total = 0;
+
+	for (int x = unique_depth - 1; x >= 0; x--) {
+		if (one_fraction != 0) {
+			double weight = next_one_portion * (unique_depth + 1) / ((x + 1) * one_fraction);
+			total += weight;
+			next_one_portion = path[x].weight - weight * zero_fraction * (unique_depth - x) / (unique_depth + 1);
+		} else {
+			total += path[x].weight / zero_fraction * (unique_depth + 1) / (unique_depth - x);
+		}
+	}
+
+	return total;
+}
+
+// Public Functions
+/*
+* Returns: - [vd] the SHAP value of every feature of the data point, followed by the expected 
+*            output of the model (together they add up to getExplainedValue)
+*/
+vd treeExplainer::explain(vd& data)
+{
+	vd phi;
+	vector<shapPathElement> path(path_size);
+	explainRow(data, phi, path);
+
+	return phi;
+}
+
+/*
+* Overloaded version of explain that can handle sets of data, the rows are handed out in 
+* chunks to the given number of worker threads (default: all cores).
+*
+* Returns: - [vvd] the explanation of each data point in the dataset
+*/
+vvd treeExplainer::explain(vvd& dataset, int threads)
+{
+	const size_t chunk_size = 64;
+	int num_threads = (threads > 0) ? threads : max(1, (int) thread::hardware_concurrency());
+	vvd explanations(dataset.size());
+
+	atomic<size_t> next_row(0);
+	auto worker = [&]() {
+		vector<shapPathElement> path(path_size);
+		for (size_t start = next_row.fetch_add(chunk_size); start < dataset.size(); start = next_row.fetch_add(chunk_size)) {
+			for (size_t x = start; x < min(start + chunk_size, dataset.size()); x++) {
+				explainRow(dataset[x], explanations[x], path);
+			}
+		}
+	};
+	vector<thread> workers;
+	for (int t = 0; t < min(num_threads, (int) ((dataset.size() + chunk_size - 1) / chunk_size)); t++) {
+		workers.push_back(thread(worker));
+	}
+	for (size_t t = 0; t < workers.size(); t++) {
+		workers[t].join();
+	}
+
+	return explanations;
+}
+
+/*
+* Returns: - [double] the output the SHAP values explain: the prediction for regression, or the 
+*            share of the (weighted) tree votes for the predicted label for classification, 
+*            which is written to class_label (ties go to the smallest label, as in randomForest)
+*/
+double treeExplainer::getExplainedValue(vd& data, double& class_label)
+{
+	if (!is_classification) {
+		double total_prediction = 0;
+		for (size_t t = 0; t < trees.size(); t++) {
+			total_prediction += tree_weights[t] * trees[t]->predict(data);
+		}
+		return total_prediction / total_weight;
+	}
+
+	map<double,double> votes;
+	for (size_t t = 0; t < trees.size(); t++) {
+		votes[trees[t]->predict(data)] += tree_weights[t];
+	}
+	double max_votes = -1;
+	for (map<double, double>::iterator itr = votes.begin(); itr != votes.end(); ++itr) {
+		if (itr->second > max_votes) {
+			class_label = itr->first;
+			max_votes = itr->second;
+		}
+	}
+
+	return max_votes / total_weight;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef TREE_EXPLAINER_H_
+#define TREE_EXPLAINER_H_
+
+#include "DecisionTree.h"
+#include "RandomForest.h"
+#include <thread>
+#include <atomic>
+
+// an element of the path of distinct features followed by TreeSHAP, see treeExplainer
+struct shapPathElement
+{
+	int feature;
+	double zero_fraction; // the fraction of the training data (cover) that goes the same way down the path
+	double one_fraction; // 1 if the explained data point goes the same way down the path, else 0
+	double weight; // the share of the feature subsets of each size that reach the end of the path
+};
+
+// exact SHAP values of a trained tree or forest's predictions, with the node frequencies as cover
+class treeExplainer
+{
+	vector<decisionTree*> trees; // the explained trees, the model must outlive the explainer
+	vd tree_weights;
+	double total_weight;
+	bool is_classification;
+	vd class_values; // NOTE: only used in classification, the labels of all the leaves in increasing order
+	vvd expected_values; // the expected output of every tree over its training data (per class for classification)
+	size_t path_size; // space for the paths of the deepest tree
+
+	void prepare();
+	double getExpectedValue(decisionTree&, int, double);
+	void explainTree(decisionTree&, int, vd&, double, double, vd&, shapPathElement*, int, double, double, int);
+	void explainRow(vd&, vd&, vector<shapPathElement>&);
+	static void extendPath(shapPathElement*, int, double, double, int);
+	static void unwindPath(shapPathElement*, int, int);
+	static double getUnwoundPathSum(shapPathElement*, int, int);
+
+public:
+	treeExplainer(decisionTree&);
+	treeExplainer(randomForest&);
+	vd explain(vd&);
+	vvd explain(vvd&, int = 0);
+	double getExplainedValue(vd&, double&);
+};
+
+#endif
@@ -29,17 +29,79 @@ int bag_size_default;
 *  - Continuous
 *   "C:\Users\ap\Documents\Visual Studio 2017\Projects\DecisionTreeProjects\DecisionTreeProjects\data\TEST-continuous_train_data.csv" "C:\Users\ap\Documents\Visual Studio 2017\Projects\DecisionTreeProjects\DecisionTreeProjects\data\TEST-continuous_test_data.csv" "C:\Users\ap\Documents\Visual Studio 2017\Projects\DecisionTreeProjects\DecisionTreeProjects\data\TEST-continuous_test_labels.csv" false true false
 *   "C:\Users\ap\Documents\Visual Studio 2017\Projects\DecisionTreeProjects\DecisionTreeProjects\data\TEST-continuous_train_data.csv" "C:\Users\ap\Documents\Visual Studio 2017\Projects\DecisionTreeProjects\DecisionTreeProjects\data\TEST-continuous_test_data.csv" "C:\Users\ap\Documents\Visual Studio 2017\Projects\DecisionTreeProjects\DecisionTreeProjects\data\TEST-continuous_test_labels.csv" false true true 200
+*
+* Alternatively, the first arg can select one of the following modes:
+*  --cv: k-fold cross-validation and hyperparameter search, see runCrossValidation
+*  --boost: gradient boosted trees, see runBoosting
+*  --sparse: decision tree on sparse data files, see runSparse
+*  --shard-train: random forest trained by several worker processes, see runShardedTraining
+*  --score: streams a data file through a saved model, see runScoring
+*  --scale: scale test on synthetic data of growing size, see runScaleTest
+*  --raw: train straight from the raw UCI records, see runRawData
+*
+* Options (can be given anywhere after the program name):
+*  --prune=rep: hold out a fifth of the training data and use it for reduced-error pruning
+*  --prune=ccp: hold out a fifth of the training data and use it to pick a cost-complexity alpha
+*  --prune=ccp:<alpha>: cost-complexity pruning with the given alpha (still holds out the data)
+*  --max-depth=<int>: limit the depth of the trees
+*  --best-first: grow the trees leaf-wise, expanding the leaf with the highest gain first
+*  --max-leaves=<int>: with --best-first, stop growing a tree once it has this many leaves
+*  --max-bytes=<int>: with --best-first, stop growing a tree once its nodes take this much memory
+*  --multiway: split discrete features into one child per value instead of two groups of values
+*  --extra-trees: split on random thresholds of a few random features (extremely randomized trees)
+*  --no-bootstrap: train every tree of the random forest on all the training data
+*  --keep-duplicates: train on every copy of duplicate rows instead of one weighted row
+*  --seed=<int>: master seed of the random forest (default 1)
+*  --save-model=<path>: save the trained (and pruned) tree or forest, e.g. for --score
+*  --lookup-table[=<max entries>]: compile the discrete tree or forest into a lookup table, see compileLookupTable
+*  --compact: deduplicate the subtrees of the random forest, see compactModel
+*  --select-trees[=<tolerance>]: keep a subset of the forest's trees about as accurate as all of them, see selectForestTrees
+*  --tree-weights: with --select-trees, a tree can be picked several times and is weighted accordingly
+*  --explain[=<threads>]: explain the test predictions with SHAP values, see explainModel
+*  --cascade[=<agreement>]: put a shallow gate tree in front of the random forest, see buildCascade
+*  --gate-depth=<int>: with --cascade, the depth of the gate tree (default 3)
 */
 int main(int argc, char* argv[])
 {
+    if (argc > 1 && string(argv[1]) == "--cv") return runCrossValidation(argc, argv);
+    if (argc > 1 && string(argv[1]) == "--boost") return runBoosting(argc, argv);
+    if (argc > 1 && string(argv[1]) == "--sparse") return runSparse(argc, argv);
+    if (argc > 1 && string(argv[1]) == "--shard-train") return runShardedTraining(argc, argv);
+    if (argc > 1 && string(argv[1]) == "--shard-worker") return runShardWorker(argc, argv);
+    if (argc > 1 && string(argv[1]) == "--score") return runScoring(argc, argv);
+    if (argc > 1 && string(argv[1]) == "--scale") return runScaleTest(argc, argv);
+    if (argc > 1 && string(argv[1]) == "--scale-worker") return runScaleWorker(argc, argv);
+    if (argc > 1 && string(argv[1]) == "--raw") return runRawData(argc, argv);
+    string prune_method = extractOption(argc, argv, "--prune");
+    string model_path = extractOption(argc, argv, "--save-model");
+    string table_limit = extractOption(argc, argv, "--lookup-table");
+    bool compact_forest = !extractOption(argc, argv, "--compact").empty();
+    string select_tolerance = extractOption(argc, argv, "--select-trees");
+    bool weighted_selection = !extractOption(argc, argv, "--tree-weights").empty();
+    string explain_threads = extractOption(argc, argv, "--explain");
+    string cascade_target = extractOption(argc, argv, "--cascade");
+    string gate_depth = extractOption(argc, argv, "--gate-depth");
+    treeOptions options = extractTreeOptions(argc, argv);
+
     wcout << L"Extracting training and testing data from files\n";
     use_forest = getBoolArg(argv[6]);
     is_discrete = getBoolArg(argv[4]);
     is_classification = getBoolArg(argv[5]);
+    if (!cascade_target.empty() && !use_forest) {
+        wcout << L"Error: the cascade needs a random forest to escalate to, please check the program call" << endl;
+        exit(-1);
+    }
     auto datasets = parseData(string(argv[1]), string(argv[2]));
     train_data = get<0>(datasets);
     test_data = get<1>(datasets);
     test_labels = parseData(string(argv[3]));
+    vvd validation_data;
+    vd validation_labels;
+    // NOTE: tree selection without bootstrapping has no out-of-bag rows, so it needs the validation data, 
+    //       and so does the calibration of the cascade
+    if (!prune_method.empty() || (!select_tolerance.empty() && use_forest && !options.bootstrap) || !cascade_target.empty()) {
+        splitValidationData(train_data, validation_data, validation_labels);
+    }
 
     wcout << L"Training Data Sample:\n[";
     for (size_t x = 0; x < train_data[0].size() - 1; x++) {
@@ -52,6 +114,9 @@ int main(int argc, char* argv[])
 	    wcout << test_data[0][x] << ", ";
     }
     wcout << test_data[0][test_data[0].size() - 1] << "]\n";
+    if (options.collapse_rows) {
+        wcout << L"Distinct Training Rows: " << decisionTree::getDistinctRowCount(train_data) << L" of " << train_data.size() << "\n";
+    }
 
     if (use_forest) {
         if (train_data.size() < 500) {
@@ -85,7 +150,16 @@ int main(int argc, char* argv[])
 	    }
 
 	    wcout << L"Building random forest...\n";
-	    randomForest forest(train_data, forest_size, bag_size, is_discrete, is_classification);
+	    randomForest forest(train_data, forest_size, bag_size, is_discrete, is_classification, options);
+	    if (!prune_method.empty()) pruneModel(forest, prune_method, validation_data, validation_labels, test_data);
+	    if (!select_tolerance.empty()) {
+	        selectForestTrees(forest, select_tolerance, weighted_selection, bag_size, options.seed, validation_data, validation_labels, test_data);
+	    }
+	    if (!model_path.empty()) saveModel(forest, model_path);
+	    if (!table_limit.empty()) compileLookupTable(forest, table_limit, train_data, test_data);
+	    if (compact_forest) compactModel(forest, test_data);
+	    if (!explain_threads.empty()) explainModel(forest, explain_threads, test_data);
+	    if (!cascade_target.empty()) buildCascade(forest, cascade_target, gate_depth, options, validation_data, test_data);
 	    forest.print(3);
 
 	    vd predictions = forest.predict(test_data);
@@ -94,7 +168,11 @@ int main(int argc, char* argv[])
     }
     else {
 	    wcout << L"Building decision tree...\n";
-	    decisionTree tree(train_data, (int)sqrt(train_data.size()), is_discrete, is_classification, use_forest);
+	    decisionTree tree(train_data, (int)sqrt(train_data.size()), is_discrete, is_classification, use_forest, options);
+	    if (!prune_method.empty()) pruneModel(tree, prune_method, validation_data, validation_labels, test_data);
+	    if (!model_path.empty()) saveModel(tree, model_path);
+	    if (!table_limit.empty()) compileLookupTable(tree, table_limit, train_data, test_data);
+	    if (!explain_threads.empty()) explainModel(tree, explain_threads, test_data);
 	    tree.print();
 
 	    vd predictions = tree.predict(test_data);
@@ -106,6 +184,1190 @@ int main(int argc, char* argv[])
     return 0;
 }
 
+/*
+* Prunes a trained tree or forest with the given method (see the options of main) and reports 
+* the node counts, depth and per-row prediction latency on the test data before and after.
+*/
+template <typename model>
+void pruneModel(model& trained_model, string method, vvd& validation_data, vd& validation_labels, vvd& timing_data)
+{
+    const int timing_reps = 10;
+    int nodes[2], leaves[2], depths[2];
+    double latencies[2];
+
+    for (int stage = 0; stage < 2; stage++) {
+        if (stage == 1) {
+            if (method == "rep") {
+                wcout << L"Applying reduced-error pruning...\n";
+                trained_model.reducedErrorPrune(validation_data, validation_labels);
+            } else if (method.compare(0, 3, "ccp") == 0) {
+                double alpha;
+                if (method.size() > 4 && method[3] == ':') {
+                    alpha = atof(method.substr(4).c_str());
+                } else {
+                    alpha = trained_model.selectPruningAlpha(validation_data, validation_labels);
+                }
+                wcout << L"Applying cost-complexity pruning with alpha = " << alpha << "\n";
+                trained_model.costComplexityPrune(alpha);
+            } else {
+                wcout << L"Error: unknown pruning method, please check the program call" << endl;
+                exit(-1);
+            }
+        }
+        nodes[stage] = trained_model.getNodeCount();
+        leaves[stage] = trained_model.getLeafCount();
+        depths[stage] = trained_model.getDepth();
+        auto predict_start = chrono::steady_clock::now();
+        for (int rep = 0; rep < timing_reps; rep++) {
+            trained_model.predict(timing_data);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - predict_start).count();
+        latencies[stage] = seconds * 1e6 / (timing_reps * max((size_t) 1, timing_data.size()));
+    }
+
+    wcout << L"Pruning Report:\n";
+    wcout << L"----------------------------------------------------------------\n";
+    wcout << setw(8) << L"" << setw(10) << L"Nodes" << setw(10) << L"Leaves" << setw(8) << L"Depth" << setw(20) << L"Predict (us/row)\n";
+    wcout << setw(8) << L"Before" << setw(10) << nodes[0] << setw(10) << leaves[0] << setw(8) << depths[0] << setw(19) << latencies[0] << "\n";
+    wcout << setw(8) << L"After" << setw(10) << nodes[1] << setw(10) << leaves[1] << setw(8) << depths[1] << setw(19) << latencies[1] << "\n";
+    wcout << L"----------------------------------------------------------------" << endl;
+}
+
+/*
+* Compiles a trained discrete tree or forest into a lookup table (see lookupTable) holding at most 
+* the given number of entries ("true" when the option has no value, meaning the default of 2^20), 
+* checks that it predicts the test data exactly like the model and reports the size of the table 
+* and the per-row prediction latency of both.
+*/
+template <typename model>
+void compileLookupTable(model& trained_model, string limit, vvd& train_data, vvd& timing_data)
+{
+    const int timing_reps = 10;
+    size_t max_entries = (limit == "true") ? (size_t) 1 << 20 : strtoull(limit.c_str(), NULL, 10);
+    if (!is_discrete) {
+        wcout << L"Error: lookup tables can only be compiled for discrete data, please check the program call" << endl;
+        exit(-1);
+    }
+
+    wcout << L"Compiling lookup table...\n";
+    auto compile_start = chrono::steady_clock::now();
+    lookupTable table(trained_model, train_data, max_entries);
+    double compile_seconds = chrono::duration<double>(chrono::steady_clock::now() - compile_start).count();
+    if (!table.isCompiled()) {
+        wcout << L"NOTE: the " << table.getCombinationCount() << L" combinations of feature values exceed the limit of " 
+            << max_entries << L" entries, the model is not compiled" << endl;
+        return;
+    }
+
+    vd model_predictions = trained_model.predict(timing_data);
+    vd table_predictions = table.predict(timing_data);
+    int matches = 0;
+    for (size_t x = 0; x < timing_data.size(); x++) {
+        if (model_predictions[x] == table_predictions[x]) matches++;
+    }
+    double latencies[2];
+    for (int stage = 0; stage < 2; stage++) {
+        auto predict_start = chrono::steady_clock::now();
+        for (int rep = 0; rep < timing_reps; rep++) {
+            if (stage == 0) {
+                trained_model.predict(timing_data);
+            } else {
+                table.predict(timing_data);
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - predict_start).count();
+        latencies[stage] = seconds * 1e6 / (timing_reps * max((size_t) 1, timing_data.size()));
+    }
+
+    wcout << L"Lookup Table Report:\n";
+    wcout << L"----------------------------------------------------------------\n";
+    wcout << L"Entries: " << table.getSize() << L" (" << table.getSize() * sizeof(double) << L" bytes), compiled in " << compile_seconds << L" s\n";
+    wcout << L"Test predictions identical to the model: " << matches << L"/" << timing_data.size() << "\n";
+    wcout << L"Predict (us/row): model " << latencies[0] << L", table " << latencies[1] << "\n";
+    wcout << L"----------------------------------------------------------------" << endl;
+    if (matches != (int) timing_data.size()) {
+        wcout << L"ERROR: the lookup table does not match the model, please check for errors" << endl;
+        exit(-1);
+    }
+}
+
+/*
+* Compacts a trained random forest into a DAG of shared subtrees (see compactForest), checks that 
+* it predicts the test data exactly like the forest and reports the number of distinct trees, the 
+* node counts and memory before and after, and the per-row prediction latency of both.
+*/
+void compactModel(randomForest& forest, vvd& timing_data)
+{
+    const int timing_reps = 10;
+
+    wcout << L"Compacting random forest...\n";
+    auto compact_start = chrono::steady_clock::now();
+    compactForest compact(forest);
+    double compact_seconds = chrono::duration<double>(chrono::steady_clock::now() - compact_start).count();
+
+    vd forest_predictions = forest.predict(timing_data);
+    vd compact_predictions = compact.predict(timing_data);
+    int matches = 0;
+    for (size_t x = 0; x < timing_data.size(); x++) {
+        if (forest_predictions[x] == compact_predictions[x]) matches++;
+    }
+    double latencies[2];
+    for (int stage = 0; stage < 2; stage++) {
+        auto predict_start = chrono::steady_clock::now();
+        for (int rep = 0; rep < timing_reps; rep++) {
+            if (stage == 0) {
+                forest.predict(timing_data);
+            } else {
+                compact.predict(timing_data);
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - predict_start).count();
+        latencies[stage] = seconds * 1e6 / (timing_reps * max((size_t) 1, timing_data.size()));
+    }
+
+    wcout << L"Compact Forest Report:\n";
+    wcout << L"----------------------------------------------------------------\n";
+    wcout << L"Trees: " << compact.getTreeCount() << L" (" << compact.getDistinctTreeCount() << L" distinct), compacted in " << compact_seconds << L" s\n";
+    wcout << setw(8) << L"" << setw(10) << L"Nodes" << setw(12) << L"Bytes" << setw(20) << L"Predict (us/row)\n";
+    wcout << setw(8) << L"Forest" << setw(10) << compact.getOriginalNodeCount() << setw(12) << compact.getOriginalBytes() << setw(19) << latencies[0] << "\n";
+    wcout << setw(8) << L"Compact" << setw(10) << compact.getNodeCount() << setw(12) << compact.getBytes() << setw(19) << latencies[1] << "\n";
+    wcout << L"Compression ratio: " << (double) compact.getOriginalBytes() / compact.getBytes() << L"x\n";
+    wcout << L"Test predictions identical to the forest: " << matches << L"/" << timing_data.size() << "\n";
+    wcout << L"----------------------------------------------------------------" << endl;
+    if (matches != (int) timing_data.size()) {
+        wcout << L"ERROR: the compacted forest does not match the forest, please check for errors" << endl;
+        exit(-1);
+    }
+}
+
+/*
+* Explains the predictions of a trained tree or forest for the test data with SHAP values (see 
+* treeExplainer), one row at a time and then batched over the given number of threads ("true" 
+* when the option has no value, meaning all cores). Checks that the values add up to the 
+* explained outputs, writes them to shap_values.txt and reports the per-row latency of both 
+* against a prediction and the mean absolute SHAP value of every feature.
+*/
+template <typename model>
+void explainModel(model& trained_model, string threads, vvd& explain_data)
+{
+    const int timing_reps = 10;
+    int num_threads = (threads == "true") ? 0 : strtol(threads.c_str(), NULL, 10);
+    size_t num_features = explain_data[0].size();
+
+    wcout << L"Explaining test predictions...\n";
+    treeExplainer explainer(trained_model);
+    double latencies[3];
+    vvd explanations;
+    for (int stage = 0; stage < 3; stage++) {
+        auto explain_start = chrono::steady_clock::now();
+        for (int rep = 0; rep < timing_reps; rep++) {
+            if (stage == 0) {
+                trained_model.predict(explain_data);
+            } else if (stage == 1) {
+                for (size_t x = 0; x < explain_data.size(); x++) {
+                    explainer.explain(explain_data[x]);
+                }
+            } else {
+                explanations = explainer.explain(explain_data, num_threads);
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - explain_start).count();
+        latencies[stage] = seconds * 1e6 / (timing_reps * max((size_t) 1, explain_data.size()));
+    }
+
+    ofstream shap_file("shap_values.txt");
+    shap_file << "label,explained value,expected value";
+    for (size_t y = 0; y < num_features; y++) {
+        shap_file << ",feature " << y;
+    }
+    shap_file << "\n";
+    double max_sum_error = 0;
+    vd mean_abs_values(num_features, 0);
+    for (size_t x = 0; x < explain_data.size(); x++) {
+        vd& phi = explanations[x];
+        double label = 0;
+        double explained_value = explainer.getExplainedValue(explain_data[x], label);
+        if (!is_classification) label = explained_value;
+        double total = phi[num_features];
+        shap_file << label << "," << explained_value << "," << phi[num_features];
+        for (size_t y = 0; y < num_features; y++) {
+            total += phi[y];
+            mean_abs_values[y] += fabs(phi[y]) / explain_data.size();
+            shap_file << "," << phi[y];
+        }
+        shap_file << "\n";
+        max_sum_error = max(max_sum_error, fabs(total - explained_value));
+    }
+    shap_file.close();
+
+    vector<int> feature_order(num_features);
+    iota(feature_order.begin(), feature_order.end(), 0);
+    stable_sort(feature_order.begin(), feature_order.end(), [&](int a, int b) { return mean_abs_values[a] > mean_abs_values[b]; });
+
+    wcout << L"Explanation Report:\n";
+    wcout << L"----------------------------------------------------------------\n";
+    wcout << L"Predict (us/row): " << latencies[0] << L", explain one row at a time: " << latencies[1] << L", batched: " << latencies[2] << "\n";
+    wcout << L"Largest error of the SHAP values plus expected value against the " 
+        << (is_classification ? L"vote share of the predicted label: " : L"prediction: ") << max_sum_error << "\n";
+    wcout << setw(10) << L"Feature" << setw(18) << L"Mean |SHAP|\n";
+    for (size_t y = 0; y < num_features; y++) {
+        wcout << setw(10) << feature_order[y] << setw(17) << mean_abs_values[feature_order[y]] << "\n";
+    }
+    wcout << L"NOTE: SHAP values recorded at shap_values.txt\n";
+    wcout << L"----------------------------------------------------------------" << endl;
+    if (max_sum_error > 1e-6) {
+        wcout << L"ERROR: the SHAP values do not add up to the model output, please check for errors" << endl;
+        exit(-1);
+    }
+}
+
+/*
+* Replaces the trees of a trained random forest by a subset (see randomForest::selectTrees) whose 
+* cross-validated accuracy (RMSE for regression) is within the given tolerance of the whole forest's ("true" when 
+* the option has no value, meaning a tolerance of 0). The subset is selected on the validation 
+* data if some was held out, otherwise out of bag, which needs the bag size and seed the forest 
+* was trained with. Reports the tree and node counts, the selection and test scores and the 
+* per-row prediction latency before and after.
+*/
+void selectForestTrees(randomForest& forest, string tolerance, bool weighted, int bag_size, unsigned int seed, 
+    vvd& validation_data, vd& validation_labels, vvd& timing_data)
+{
+    const int timing_reps = 10;
+    double tolerance_value = (tolerance == "true") ? 0 : atof(tolerance.c_str());
+    int trees[2], nodes[2];
+    double latencies[2], test_scores[2], selection_errors[2];
+
+    for (int stage = 0; stage < 2; stage++) {
+        if (stage == 1) {
+            wcout << L"Selecting trees " << (validation_data.empty() ? L"out of bag" : L"on the validation data") << L"...\n";
+            auto select_start = chrono::steady_clock::now();
+            if (validation_data.empty()) {
+                selection_errors[1] = forest.selectTreesOutOfBag(train_data, bag_size, seed, tolerance_value, weighted, selection_errors[0]);
+            } else {
+                selection_errors[1] = forest.selectTrees(validation_data, validation_labels, seed, tolerance_value, weighted, selection_errors[0]);
+            }
+            wcout << L"Selected in " << chrono::duration<double>(chrono::steady_clock::now() - select_start).count() << L" s\n";
+        }
+        trees[stage] = forest.getTreeCount();
+        nodes[stage] = forest.getNodeCount();
+        vd predictions = forest.predict(timing_data);
+        statsAccumulator stats(is_classification);
+        for (size_t x = 0; x < predictions.size(); x++) {
+            stats.add(test_labels[x], predictions[x]);
+        }
+        test_scores[stage] = is_classification ? stats.getAccuracy() : stats.getRMSE();
+        auto predict_start = chrono::steady_clock::now();
+        for (int rep = 0; rep < timing_reps; rep++) {
+            forest.predict(timing_data);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - predict_start).count();
+        latencies[stage] = seconds * 1e6 / (timing_reps * max((size_t) 1, timing_data.size()));
+    }
+    for (int stage = 0; stage < 2; stage++) {
+        if (is_classification) selection_errors[stage] = 1 - selection_errors[stage];
+    }
+
+    wstring score_name = is_classification ? L"Accuracy" : L"RMSE";
+    wstring selection_name = (validation_data.empty() ? L"OOB " : L"Validation ") + score_name;
+    wcout << L"Tree Selection Report:\n";
+    wcout << L"----------------------------------------------------------------\n";
+    wcout << setw(8) << L"" << setw(8) << L"Trees" << setw(10) << L"Nodes" << setw(21) << selection_name << setw(15) << (L"Test " + score_name) 
+        << setw(20) << L"Predict (us/row)\n";
+    wcout << setw(8) << L"Before" << setw(8) << trees[0] << setw(10) << nodes[0] << setw(21) << selection_errors[0] << setw(15) << test_scores[0] 
+        << setw(19) << latencies[0] << "\n";
+    wcout << setw(8) << L"After" << setw(8) << trees[1] << setw(10) << nodes[1] << setw(21) << selection_errors[1] << setw(15) << test_scores[1] 
+        << setw(19) << latencies[1] << "\n";
+    wcout << L"NOTE: the selection score after is cross-validated over " << (validation_data.empty() ? L"the training" : L"the validation") 
+        << L" rows (3 folds), the score before is the whole forest's on all of them\n";
+    wcout << L"----------------------------------------------------------------" << endl;
+}
+
+/*
+* Trains a shallow gate tree (of the given depth, "true" when the option has no value, meaning a 
+* depth of 3) on the training data and puts it in front of the trained random forest (see 
+* cascadeModel), with the threshold calibrated on the held-out data to agree with the forest on 
+* the given share of it ("true" meaning 0.99). Reports the chosen threshold and, for the gate, the 
+* forest and the cascade, the test accuracy, the agreement with the forest, the share of the test 
+* data escalated to the forest, the mean per-row prediction latency and the throughput.
+*/
+void buildCascade(randomForest& forest, string target, string gate_depth, treeOptions options, vvd& calibration_data, vvd& timing_data)
+{
+    const int timing_reps = 10;
+    double target_agreement = (target == "true") ? 0.99 : atof(target.c_str());
+    options.max_depth = (gate_depth.empty() || gate_depth == "true") ? 3 : strtol(gate_depth.c_str(), NULL, 10);
+    if (!is_classification) {
+        wcout << L"Error: the cascade needs a classification forest, please check the program call" << endl;
+        exit(-1);
+    }
+
+    wcout << L"Training gate tree for the cascade...\n";
+    auto gate_start = chrono::steady_clock::now();
+    decisionTree gate(train_data, (int)sqrt(train_data.size()), is_discrete, is_classification, false, options);
+    double gate_seconds = chrono::duration<double>(chrono::steady_clock::now() - gate_start).count();
+    cascadeModel cascade(gate, forest);
+    auto calibration = cascade.calibrate(calibration_data, target_agreement);
+
+    // stage 0 is the gate alone, stage 1 the forest alone and stage 2 the cascade
+    vd predictions[3];
+    double test_scores[3], agreements[3], escalation_rates[3], latencies[3];
+    for (int stage = 0; stage < 3; stage++) {
+        cascade.setThreshold((stage == 0) ? 0 : get<0>(calibration));
+        predictions[stage] = (stage == 1) ? forest.predict(timing_data) : cascade.predict(timing_data);
+        cascade.resetStats();
+        auto predict_start = chrono::steady_clock::now();
+        for (int rep = 0; rep < timing_reps; rep++) {
+            if (stage == 1) {
+                forest.predict(timing_data);
+            } else {
+                cascade.predict(timing_data);
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - predict_start).count();
+        latencies[stage] = seconds * 1e6 / (timing_reps * max((size_t) 1, timing_data.size()));
+        escalation_rates[stage] = (stage == 1) ? 1 : cascade.getEscalationRate();
+    }
+    cascade.setThreshold(get<0>(calibration));
+    for (int stage = 0; stage < 3; stage++) {
+        statsAccumulator stats(is_classification);
+        int matches = 0;
+        for (size_t x = 0; x < predictions[stage].size(); x++) {
+            stats.add(test_labels[x], predictions[stage][x]);
+            if (predictions[stage][x] == predictions[1][x]) matches++;
+        }
+        test_scores[stage] = stats.getAccuracy();
+        agreements[stage] = matches / (double) max((size_t) 1, timing_data.size());
+    }
+
+    const wchar_t* stage_names[3] = { L"Gate", L"Forest", L"Cascade" };
+    wcout << L"Cascade Report:\n";
+    wcout << L"----------------------------------------------------------------\n";
+    wcout << L"Gate tree: depth " << gate.getDepth() << L", " << gate.getLeafCount() << L" leaves, trained in " << gate_seconds << L" s\n";
+    wcout << L"Threshold: " << get<0>(calibration) << L" (target agreement " << target_agreement << L"), on the " << calibration_data.size() 
+        << L" calibration rows: agreement " << get<1>(calibration) << L", escalation rate " << get<2>(calibration) << "\n";
+    wcout << setw(8) << L"" << setw(15) << L"Test Accuracy" << setw(11) << L"Agreement" << setw(11) << L"Escalated" << setw(18) << L"Predict (us/row)" 
+        << setw(22) << L"Throughput (rows/s)\n";
+    for (int stage = 0; stage < 3; stage++) {
+        wcout << setw(8) << stage_names[stage] << setw(15) << test_scores[stage] << setw(11) << agreements[stage] << setw(11) << escalation_rates[stage] 
+            << setw(18) << latencies[stage] << setw(21) << 1e6 / latencies[stage] << "\n";
+    }
+    wcout << L"----------------------------------------------------------------" << endl;
+}
+
+/*
+* Args: 1. --cv
+*       2. [string] the path to the training data csv file
+*       3. [bool] determines whether or not the data is discrete [T] or continuous [F]
+*       4. [bool] determines whether or not the task is classification [T] or regression [F]
+*       5. [int] <optional> number of folds (default 5)
+*       6. [int] <optional> number of worker threads (default: all cores)
+*
+* The training data is parsed once and the default grid (see crossValidator::getDefaultGrid) 
+* is evaluated on every fold in-process.
+*/
+int runCrossValidation(int argc, char* argv[])
+{
+    if (argc < 5) {
+        wcout << L"Error: cross-validation expects the training data path, discrete flag and classification flag" << endl;
+        exit(-1);
+    }
+    bool cv_discrete = getBoolArg(argv[3]);
+    bool cv_classification = getBoolArg(argv[4]);
+    int folds = (argc > 5) ? strtol(argv[5], NULL, 10) : 5;
+    int threads = (argc > 6) ? strtol(argv[6], NULL, 10) : 0;
+
+    wcout << L"Extracting training data from file\n";
+    vvd cv_data = parseDataset(string(argv[2]));
+
+    auto search_start = chrono::steady_clock::now();
+    crossValidator validator(cv_data, folds, cv_discrete, cv_classification, threads, 1);
+    vector<hyperParams> grid = crossValidator::getDefaultGrid(cv_data.size() - cv_data.size() / folds);
+    wcout << L"Evaluating " << grid.size() << L" settings with " << folds << L"-fold cross-validation...\n";
+    vector<cvResult> results = validator.gridSearch(grid);
+    double search_seconds = chrono::duration<double>(chrono::steady_clock::now() - search_start).count();
+
+    validator.printResults(results);
+    wcout << L"Total wall time: " << search_seconds << L" s" << endl;
+
+    return 0;
+}
+
+/*
+* Args: 1. --boost
+*       2. [string] the path to the training data csv file
+*       3. [string] the path to the testing data csv file
+*       4. [string] the path to the testing data labels csv file
+*       5. [bool] determines whether or not the data is discrete [T] or continuous [F]
+*       6. [bool] determines whether or not the task is classification [T] or regression [F]
+*       7. [int] <optional> maximum number of boosting rounds (default 200)
+*       8. [double] <optional> learning rate (default 0.1)
+*       9. [int] <optional> maximum depth of each tree (default 3)
+*      10. [int] <optional> early stopping patience, the rounds without improvement of the 
+*          validation loss before training stops (default 10)
+*
+* Options: --save-model=<path> saves the boosted forest, e.g. for --score.
+*
+* A random fifth of the training data is held out as the validation set for early stopping.
+*/
+int runBoosting(int argc, char* argv[])
+{
+    string model_path = extractOption(argc, argv, "--save-model");
+    if (argc < 7) {
+        wcout << L"Error: boosting expects the data paths, discrete flag and classification flag" << endl;
+        exit(-1);
+    }
+    bool boost_discrete = getBoolArg(argv[5]);
+    bool boost_classification = getBoolArg(argv[6]);
+    int max_rounds = (argc > 7) ? strtol(argv[7], NULL, 10) : 200;
+    double learning_rate = (argc > 8) ? atof(argv[8]) : 0.1;
+    int max_depth = (argc > 9) ? strtol(argv[9], NULL, 10) : 3;
+    int patience = (argc > 10) ? strtol(argv[10], NULL, 10) : 10;
+
+    wcout << L"Extracting training and testing data from files\n";
+    auto datasets = parseData(string(argv[2]), string(argv[3]));
+    vvd boost_train_data = get<0>(datasets);
+    vvd boost_test_data = get<1>(datasets);
+    vd boost_test_labels = parseData(string(argv[4]));
+
+    vvd validation_data;
+    vd validation_labels;
+    splitValidationData(boost_train_data, validation_data, validation_labels);
+
+    wcout << L"Building boosted forest...\n";
+    boostedForest boosted(boost_train_data, validation_data, validation_labels, max_rounds, learning_rate, max_depth, patience, 
+        boost_discrete, boost_classification);
+    if (!model_path.empty()) saveModel(boosted, model_path);
+    boosted.print(3);
+
+    vd predictions = boosted.predict(boost_test_data);
+    wstring filename = L"boosted_forest_output.txt";
+    boosted.getStatsInfo(boost_test_labels, predictions, filename);
+
+    return 0;
+}
+
+/*
+* Args: 1. --sparse
+*       2. [string] the path to the sparse training data file
+*       3. [string] the path to the sparse testing data file
+*       4. [bool] determines whether or not the task is classification [T] or regression [F]
+*
+* Both files hold one "label col:value col:value ..." line per data point (see parseSparseData), 
+* the tree is continuous and only ever looks at the non-zero entries.
+*/
+int runSparse(int argc, char* argv[])
+{
+    if (argc < 5) {
+        wcout << L"Error: sparse mode expects the training and testing data paths and the classification flag" << endl;
+        exit(-1);
+    }
+    bool sparse_classification = getBoolArg(argv[4]);
+
+    wcout << L"Extracting sparse training and testing data from files\n";
+    auto train_set = parseSparseData(string(argv[2]));
+    auto test_set = parseSparseData(string(argv[3]));
+    csrMatrix& sparse_train_data = get<0>(train_set);
+    csrMatrix& sparse_test_data = get<0>(test_set);
+    wcout << L"Training data: " << sparse_train_data.num_rows << L" rows, " << sparse_train_data.num_cols << L" columns, " 
+        << sparse_train_data.values.size() << L" non-zeros\n";
+
+    wcout << L"Building sparse decision tree...\n";
+    auto train_start = chrono::steady_clock::now();
+    decisionTree tree(sparse_train_data, get<1>(train_set), (int) sqrt(sparse_train_data.num_rows), sparse_classification);
+    double train_seconds = chrono::duration<double>(chrono::steady_clock::now() - train_start).count();
+    wcout << L"Training time: " << train_seconds << L" s (" << tree.getNodeCount() << L" nodes)\n";
+
+    vd predictions = tree.predict(sparse_test_data);
+    wstring filename = L"sparse_decision_tree_output.txt";
+    tree.getStatsInfo(get<1>(test_set), predictions, filename);
+
+    return 0;
+}
+
+/*
+* Args: 1. --raw
+*       2. [string] comma-separated paths of the raw UCI data files (e.g. data/raw/cleveland.data.txt)
+*       3. [string] comma-separated attribute numbers to project, the last one is the label, or 
+*                   "discrete" / "continuous" for the attributes of the csv datasets (see parseAttributeList)
+*       4. [bool] determines whether or not the data is discrete [T] or continuous [F]
+*       5. [bool] determines whether or not the task is classification [T] or regression [F]
+*       6. [bool] determines whether or not to use a random forest
+*       7. [int] <optional> number of trees in random forest (default 1000)
+*
+* Options: the tree options of main, and --drop-missing to skip the records with a missing (-9) 
+* projected attribute.
+*
+* Trains straight from the raw multi-line records (see parseRawData), merging all the given 
+* sources, without converting them to csv files first. A random fifth of the records is held 
+* out as the testing data.
+*/
+int runRawData(int argc, char* argv[])
+{
+    bool drop_missing = !extractOption(argc, argv, "--drop-missing").empty();
+    treeOptions options = extractTreeOptions(argc, argv);
+    if (argc < 7) {
+        wcout << L"Error: the raw data mode expects the raw files, attribute numbers, discrete, classification and forest flags" << endl;
+        exit(-1);
+    }
+    vector<string> raw_paths;
+    string path_list = argv[2];
+    for (size_t start = 0; start <= path_list.size(); ) {
+        size_t comma = min(path_list.find(',', start), path_list.size());
+        raw_paths.push_back(path_list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    vector<int> attributes = parseAttributeList(argv[3]);
+    bool raw_discrete = getBoolArg(argv[4]);
+    bool raw_classification = getBoolArg(argv[5]);
+    bool raw_forest = getBoolArg(argv[6]);
+    int forest_size = (argc > 7) ? strtol(argv[7], NULL, 10) : forest_size_default;
+
+    wcout << L"Extracting raw records from " << raw_paths.size() << L" files\n";
+    auto load_start = chrono::steady_clock::now();
+    columnarData raw_data = parseRawData(raw_paths, attributes, drop_missing);
+    double load_seconds = chrono::duration<double>(chrono::steady_clock::now() - load_start).count();
+    for (size_t s = 0; s < raw_data.source_names.size(); s++) {
+        wcout << L"  " << raw_data.source_names[s].c_str() << L": " << raw_data.source_rows[s] << L" records (" 
+            << raw_data.source_skipped[s] << L" skipped)\n";
+    }
+    wcout << L"Loaded " << raw_data.num_rows << L" records x " << attributes.size() << L" attributes in " << load_seconds << L" s (" 
+        << raw_data.num_bytes / 1e6 / max(load_seconds, 1e-9) << L" MB/s)\n";
+    if (raw_data.num_rows < 10) {
+        wcout << L"Error: not enough records to train on, please check the raw data files" << endl;
+        exit(-1);
+    }
+
+    vvd raw_train_data = getRows(raw_data);
+    vvd raw_test_data;
+    vd raw_test_labels;
+    splitValidationData(raw_train_data, raw_test_data, raw_test_labels);
+
+    vd predictions;
+    wstring filename;
+    if (raw_forest) {
+        wcout << L"Building random forest...\n";
+        randomForest forest(raw_train_data, forest_size, raw_train_data.size(), raw_discrete, raw_classification, options);
+        predictions = forest.predict(raw_test_data);
+        filename = L"raw_random_forest_output.txt";
+        forest.getStatsInfo(raw_test_labels, predictions, filename);
+    } else {
+        wcout << L"Building decision tree...\n";
+        decisionTree tree(raw_train_data, (int) sqrt(raw_train_data.size()), raw_discrete, raw_classification, false, options);
+        predictions = tree.predict(raw_test_data);
+        filename = L"raw_decision_tree_output.txt";
+        tree.getStatsInfo(raw_test_labels, predictions, filename);
+    }
+
+    return 0;
+}
+
+/*
+* Args: 1. --score
+*       2. [string] the path to a tree, forest or boosted forest model file written with --save-model
+*          (or by --shard-train)
+*       3. [string] the path to the data csv file to score
+*       4. [string] the path to the labels csv file of that data
+*       5. [bool] determines whether or not the task is classification [T] or regression [F]
+*       6. [string] <optional> the path to write the predictions to (default scored_output.txt)
+*       7. [int] <optional> number of rows per chunk (default 4096)
+*
+* The data is never loaded as a whole: it is read a chunk at a time, every chunk is run through 
+* the model and its predictions are appended to the (buffered) results file, while accuracy, the 
+* confusion matrix and MAE/RMSE are accumulated in the same pass. Memory use does not depend on 
+* the size of the data file.
+*/
+int runScoring(int argc, char* argv[])
+{
+    if (argc < 6) {
+        wcout << L"Error: scoring expects the model path, data path, labels path and classification flag" << endl;
+        exit(-1);
+    }
+    bool score_classification = getBoolArg(argv[5]);
+    string output_path = (argc > 6) ? string(argv[6]) : "scored_output.txt";
+    size_t chunk_rows = (argc > 7) ? max(1L, strtol(argv[7], NULL, 10)) : 4096;
+    wstring filename(output_path.begin(), output_path.end());
+
+    ifstream model_file(argv[2]);
+    string model_type;
+    model_file >> model_type;
+    model_file.seekg(0);
+    if (!model_file || (model_type != "tree" && model_type != "forest" && model_type != "boosted")) {
+        wcerr << L"Error: Invalid path to model file" << endl;
+        exit(-1);
+    }
+
+    wcout << L"Scoring " << argv[3] << L" in chunks of " << chunk_rows << L" rows...\n";
+    auto score_start = chrono::steady_clock::now();
+    size_t bytes_read = 0;
+    statsAccumulator stats(score_classification);
+    if (model_type == "forest") {
+        randomForest forest(model_file);
+        stats = scoreStream(forest, string(argv[3]), string(argv[4]), filename, score_classification, chunk_rows, bytes_read);
+    } else if (model_type == "boosted") {
+        boostedForest boosted(model_file);
+        stats = scoreStream(boosted, string(argv[3]), string(argv[4]), filename, score_classification, chunk_rows, bytes_read);
+    } else {
+        decisionTree tree(model_file);
+        stats = scoreStream(tree, string(argv[3]), string(argv[4]), filename, score_classification, chunk_rows, bytes_read);
+    }
+    double score_seconds = chrono::duration<double>(chrono::steady_clock::now() - score_start).count();
+
+    wcout << L"Statistics:\n";
+    wcout << L"NOTE: testing results recorded at " << filename << "\n";
+    stats.print();
+    wcout << L"Scored " << stats.getCount() << L" rows in " << score_seconds << L" s (" << stats.getCount() / score_seconds 
+        << L" rows/s, " << bytes_read / 1e6 / score_seconds << L" MB/s of input)" << endl;
+
+    return 0;
+}
+
+/*
+* Reads the data and labels files chunk_rows lines at a time (reusing the chunk's rows), predicts 
+* every chunk with the model and writes the results to filename.
+*
+* Returns: - [statsAccumulator] the metrics of all the scored rows
+*/
+template <typename model>
+statsAccumulator scoreStream(model& trained_model, string data_csv, string labels_csv, wstring filename, bool classification, 
+    size_t chunk_rows, size_t& bytes_read)
+{
+    ifstream data_file(data_csv);
+    ifstream labels_file(labels_csv);
+    if (!data_file || !labels_file) {
+        wcerr << L"Error: Invalid path to data or labels file" << endl;
+        exit(-1);
+    }
+
+    statsReport report(filename, classification);
+    vvd chunk(chunk_rows);
+    vd chunk_labels(chunk_rows);
+    string data_string;
+    string label_string;
+    size_t num_rows = chunk_rows;
+    while (num_rows == chunk_rows) {
+        num_rows = 0;
+        while (num_rows < chunk_rows && getline(data_file, data_string)) {
+            if (!getline(labels_file, label_string)) {
+                wcerr << L"Error: the labels file has fewer lines than the data file" << endl;
+                exit(-1);
+            }
+            bytes_read += data_string.size() + label_string.size() + 2;
+            parseDataLine(data_string, chunk[num_rows]);
+            chunk_labels[num_rows] = atof(label_string.c_str());
+            num_rows++;
+        }
+        for (size_t x = 0; x < num_rows; x++) {
+            report.add(chunk_labels[x], trained_model.predict(chunk[x]));
+        }
+    }
+
+    return report.finish();
+}
+
+/*
+* Saves a trained tree, forest or boosted forest so it can be scored later, see runScoring.
+*/
+template <typename model>
+void saveModel(model& trained_model, string path)
+{
+    ofstream model_file(path);
+    trained_model.save(model_file);
+    model_file.close();
+    if (!model_file) {
+        wcerr << L"Error: could not write the model file" << endl;
+        exit(-1);
+    }
+    wcout << L"NOTE: model saved at " << path.c_str() << "\n";
+}
+
+/*
+* Args: 1. --shard-train
+*       2. [string] the path to the training data csv file
+*       3. [string] the path to the testing data csv file
+*       4. [string] the path to the testing data labels csv file
+*       5. [bool] determines whether or not the data is discrete [T] or continuous [F]
+*       6. [bool] determines whether or not the task is classification [T] or regression [F]
+*       7. [int] number of trees in random forest
+*       8. [int] number of worker processes
+*       9. [int] <optional> amount of bootstrap data per forest tree
+*
+* Options: the tree options of main (including --seed), and --verify to also build the forest in 
+* this process and check that the merged forest is identical to it.
+*
+* Local coordinator for sharded training: the trees are split into one contiguous range per 
+* worker, and every worker is a copy of this program (see runShardWorker) that trains its range 
+* and writes it to random_forest_shard_<k>.txt. The shards are then merged in order, saved to 
+* random_forest_model.txt and evaluated on the test data. Since each tree is seeded from the 
+* master seed and its index, the result does not depend on the number of workers.
+*/
+int runShardedTraining(int argc, char* argv[])
+{
+    bool verify = !extractOption(argc, argv, "--verify").empty();
+    treeOptions options = extractTreeOptions(argc, argv);
+    if (argc < 9) {
+        wcout << L"Error: sharded training expects the data paths, discrete flag, classification flag, forest size and number of workers" << endl;
+        exit(-1);
+    }
+    bool shard_discrete = getBoolArg(argv[5]);
+    bool shard_classification = getBoolArg(argv[6]);
+    int forest_size = strtol(argv[7], NULL, 10);
+    int num_workers = max(1, min((int) strtol(argv[8], NULL, 10), forest_size));
+
+    wcout << L"Extracting training and testing data from files\n";
+    auto datasets = parseData(string(argv[2]), string(argv[3]));
+    vvd shard_train_data = get<0>(datasets);
+    vvd shard_test_data = get<1>(datasets);
+    vd shard_test_labels = parseData(string(argv[4]));
+    int bag_size = (argc > 9) ? strtol(argv[9], NULL, 10) : shard_train_data.size();
+
+    wcout << L"Training " << forest_size << L" trees with " << num_workers << L" worker processes...\n";
+    auto train_start = chrono::steady_clock::now();
+    vector<string> shard_files;
+    vector<int> exit_codes(num_workers);
+    vector<thread> workers;
+    for (int w = 0; w < num_workers; w++) {
+        int first = (int) ((long long) forest_size * w / num_workers);
+        int last = (int) ((long long) forest_size * (w + 1) / num_workers);
+        shard_files.push_back("random_forest_shard_" + to_string(w) + ".txt");
+        string command = quoteArg(argv[0]) + " --shard-worker " + quoteArg(argv[2]) + " " + argv[5] + " " + argv[6] + " " 
+            + to_string(first) + " " + to_string(last) + " " + to_string(bag_size) + " " + quoteArg(shard_files[w]) 
+            + getTreeOptionArgs(options);
+        workers.push_back(thread([command, w, &exit_codes]() { exit_codes[w] = runCommand(command); }));
+    }
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+    for (int w = 0; w < num_workers; w++) {
+        if (exit_codes[w] != 0) {
+            wcout << L"Error: worker " << w << L" failed with exit code " << exit_codes[w] << endl;
+            exit(-1);
+        }
+    }
+
+    // merge the partial forests in tree order
+    ifstream shard_file(shard_files[0]);
+    randomForest forest(shard_file);
+    shard_file.close();
+    for (int w = 1; w < num_workers; w++) {
+        shard_file.clear();
+        shard_file.open(shard_files[w]);
+        randomForest shard(shard_file);
+        shard_file.close();
+        forest.merge(shard);
+    }
+    double train_seconds = chrono::duration<double>(chrono::steady_clock::now() - train_start).count();
+    wcout << L"Training and merging time: " << train_seconds << L" s\n";
+
+    ofstream model_file("random_forest_model.txt");
+    forest.save(model_file);
+    model_file.close();
+    wcout << L"NOTE: merged forest saved at random_forest_model.txt\n";
+
+    if (verify) {
+        treeOptions reference_options = options;
+        reference_options.verbose = false;
+        randomForest reference(shard_train_data, forest_size, bag_size, shard_discrete, shard_classification, reference_options);
+        ostringstream merged_text;
+        ostringstream reference_text;
+        forest.save(merged_text);
+        reference.save(reference_text);
+        bool identical = merged_text.str() == reference_text.str();
+        wcout << L"Merged forest identical to a single-process build: " << (identical ? L"yes" : L"NO") << "\n";
+        if (!identical) exit(-1);
+    }
+
+    vd predictions = forest.predict(shard_test_data);
+    wstring filename = L"random_forest_output.txt";
+    forest.getStatsInfo(shard_test_labels, predictions, filename);
+
+    return 0;
+}
+
+/*
+* Args: 1. --shard-worker
+*       2. [string] the path to the training data csv file
+*       3. [bool] determines whether or not the data is discrete [T] or continuous [F]
+*       4. [bool] determines whether or not the task is classification [T] or regression [F]
+*       5. [int] index of the first tree of the shard
+*       6. [int] index one past the last tree of the shard
+*       7. [int] amount of bootstrap data per forest tree
+*       8. [string] the path to write the partial forest to
+*
+* Options: the tree options of main (including --seed).
+*
+* Started by runShardedTraining, but can just as well be run by hand (e.g. on other machines) 
+* as long as every shard uses the same training data, options and seed.
+*/
+int runShardWorker(int argc, char* argv[])
+{
+    treeOptions options = extractTreeOptions(argc, argv);
+    options.verbose = false;
+    if (argc < 9) {
+        wcout << L"Error: shard worker expects the training data path, discrete flag, classification flag, tree range, bag size and output path" << endl;
+        exit(-1);
+    }
+    bool shard_discrete = getBoolArg(argv[3]);
+    bool shard_classification = getBoolArg(argv[4]);
+    int first = strtol(argv[5], NULL, 10);
+    int last = strtol(argv[6], NULL, 10);
+    int bag_size = strtol(argv[7], NULL, 10);
+
+    vvd shard_data = parseDataset(string(argv[2]));
+    randomForest shard(shard_data, make_pair(first, last), bag_size, shard_discrete, shard_classification, options);
+
+    ofstream output_file(argv[8]);
+    shard.save(output_file);
+    output_file.close();
+    if (!output_file) {
+        wcerr << L"Error: could not write the forest shard file" << endl;
+        exit(-1);
+    }
+
+    return 0;
+}
+
+/*
+* Args: 1. --scale
+*       2. [string] the path to the training data csv file used as a template
+*       3. [bool] determines whether or not the data is discrete [T] or continuous [F]
+*       4. [bool] determines whether or not the task is classification [T] or regression [F]
+*       5. [int] <optional> largest number of training rows (default 100000), the sizes are the 
+*                powers of 10 from 10^4 up to it
+*       6. [int] <optional> feature multiplier, the number of copies of the template's columns (default 1)
+*       7. [int] <optional> number of trees in random forest (default 10)
+*
+* Options: the tree options of main (including --seed), passed on to the runs.
+*
+* Scale test harness: for every size, synthetic training and testing data shaped like the 
+* template (see generateSyntheticData, the testing data has a tenth of the rows) is written to 
+* scale_train_data.csv, scale_test_data.csv and scale_test_labels.csv, then a decision tree and 
+* a random forest are run through the whole pipeline (load, train, predict, report) by a copy 
+* of this program (see runScaleWorker), each in its own process so that its peak memory is its 
+* own. The wall time of every stage (the report stage writes every prediction to the results 
+* file, so it is kept out of the prediction time and throughput), the peak resident memory, the 
+* throughput and the accuracy (or RMSE) are printed as a table and appended to scaling_table.txt, which can be kept to 
+* compare releases.
+*/
+int runScaleTest(int argc, char* argv[])
+{
+    treeOptions options = extractTreeOptions(argc, argv);
+    if (argc < 5) {
+        wcout << L"Error: the scale test expects the template data path, discrete flag and classification flag" << endl;
+        exit(-1);
+    }
+    bool scale_discrete = getBoolArg(argv[3]);
+    bool scale_classification = getBoolArg(argv[4]);
+    long long max_rows = (argc > 5) ? strtoll(argv[5], NULL, 10) : 100000;
+    int feature_multiplier = (argc > 6) ? max(1L, strtol(argv[6], NULL, 10)) : 1;
+    int forest_size = (argc > 7) ? max(1L, strtol(argv[7], NULL, 10)) : 10;
+
+    vvd template_data = parseDataset(string(argv[2]));
+    int num_features = (template_data[0].size() - 1) * feature_multiplier;
+    string train_path = "scale_train_data.csv";
+    string test_path = "scale_test_data.csv";
+    string labels_path = "scale_test_labels.csv";
+    string metrics_path = "scale_metrics.txt";
+
+    ofstream table_file("scaling_table.txt", ios::app);
+    time_t now = time(nullptr);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    ostringstream header;
+    header << "# " << date << ", template " << argv[2] << ", discrete " << (scale_discrete ? "true" : "false") 
+        << ", classification " << (scale_classification ? "true" : "false") << ", " << forest_size << " trees" << getTreeOptionArgs(options) << "\n";
+    header << setw(7) << "Model" << setw(10) << "Rows" << setw(10) << "Features" << setw(10) << "Load (s)" << setw(11) << "Train (s)" 
+        << setw(13) << "Predict (s)" << setw(12) << "Report (s)" << setw(11) << "Peak (MB)" << setw(14) << "Train rows/s" << setw(16) << "Predict rows/s" 
+        << setw(10) << (scale_classification ? "Accuracy" : "RMSE") << "\n";
+    wcout << L"Scale Test Results:\n";
+    wcout << L"----------------------------------------------------------------\n";
+    wcout << header.str().c_str() << flush;
+    table_file << header.str();
+
+    for (long long num_rows = 10000; num_rows <= max_rows; num_rows *= 10) {
+        long long num_test_rows = num_rows / 10;
+        generateSyntheticData(template_data, num_rows, num_test_rows, feature_multiplier, options.seed, train_path, test_path, labels_path);
+        for (int use_forest_run = 0; use_forest_run < 2; use_forest_run++) {
+            string command = quoteArg(argv[0]) + " --scale-worker " + quoteArg(train_path) + " " + quoteArg(test_path) + " " 
+                + quoteArg(labels_path) + " " + (scale_discrete ? "true" : "false") + " " + (scale_classification ? "true" : "false") + " " + (use_forest_run ? "true" : "false") + " " 
+                + to_string(forest_size) + " " + quoteArg(metrics_path) + getTreeOptionArgs(options);
+            int exit_code = runCommand(command);
+            ifstream metrics_file(metrics_path);
+            double load_seconds, train_seconds, predict_seconds, report_seconds, peak_bytes, score;
+            metrics_file >> load_seconds >> train_seconds >> predict_seconds >> report_seconds >> peak_bytes >> score;
+            if (exit_code != 0 || !metrics_file) {
+                wcout << L"Error: the run with " << num_rows << L" rows failed with exit code " << exit_code << endl;
+                exit(-1);
+            }
+            metrics_file.close();
+            remove(metrics_path.c_str());
+
+            ostringstream row;
+            row << setw(7) << (use_forest_run ? "forest" : "tree") << setw(10) << num_rows << setw(10) << num_features 
+                << setw(10) << load_seconds << setw(11) << train_seconds << setw(13) << predict_seconds << setw(12) << report_seconds << setw(11) << peak_bytes / 1e6 
+                << setw(14) << num_rows / train_seconds << setw(16) << num_test_rows / predict_seconds << setw(10) << score << "\n";
+            wcout << row.str().c_str() << flush;
+            table_file << row.str() << flush;
+        }
+    }
+    wcout << L"----------------------------------------------------------------\n";
+    wcout << L"NOTE: results appended to scaling_table.txt" << endl;
+    remove(train_path.c_str());
+    remove(test_path.c_str());
+    remove(labels_path.c_str());
+    remove("scale_output.txt");
+
+    return 0;
+}
+
+/*
+* Args: 1. --scale-worker
+*       2. [string] the path to the training data csv file
+*       3. [string] the path to the testing data csv file
+*       4. [string] the path to the testing data labels csv file
+*       5. [bool] determines whether or not the data is discrete [T] or continuous [F]
+*       6. [bool] determines whether or not the task is classification [T] or regression [F]
+*       7. [bool] determines whether or not to use a random forest
+*       8. [int] number of trees in random forest
+*       9. [string] the path to write the metrics to
+*
+* Options: the tree options of main (including --seed).
+*
+* One run of the scale test (see runScaleTest): loads the data, trains the model the same way 
+* main does, predicts the testing data and writes the results file (scale_output.txt). The 
+* metrics file gets a single line: the load, train, predict and report (writing the results 
+* file) times in seconds, the peak resident memory of the process in bytes and the accuracy 
+* (RMSE for regression).
+*/
+int runScaleWorker(int argc, char* argv[])
+{
+    treeOptions options = extractTreeOptions(argc, argv);
+    options.verbose = false;
+    if (argc < 10) {
+        wcout << L"Error: scale worker expects the data paths, discrete, classification and forest flags, forest size and metrics path" << endl;
+        exit(-1);
+    }
+    bool scale_discrete = getBoolArg(argv[5]);
+    bool scale_classification = getBoolArg(argv[6]);
+    bool scale_forest = getBoolArg(argv[7]);
+    int forest_size = strtol(argv[8], NULL, 10);
+
+    auto load_start = chrono::steady_clock::now();
+    auto datasets = parseData(string(argv[2]), string(argv[3]));
+    vvd& scale_train_data = get<0>(datasets);
+    vvd& scale_test_data = get<1>(datasets);
+    vd scale_test_labels = parseData(string(argv[4]));
+    auto train_start = chrono::steady_clock::now();
+    vd predictions;
+    chrono::steady_clock::time_point predict_start;
+    chrono::steady_clock::time_point predict_end;
+    if (scale_forest) {
+        randomForest forest(scale_train_data, forest_size, scale_train_data.size(), scale_discrete, scale_classification, options);
+        predict_start = chrono::steady_clock::now();
+        predictions = forest.predict(scale_test_data);
+        predict_end = chrono::steady_clock::now();
+    } else {
+        decisionTree tree(scale_train_data, (int) sqrt(scale_train_data.size()), scale_discrete, scale_classification, false, options);
+        predict_start = chrono::steady_clock::now();
+        predictions = tree.predict(scale_test_data);
+        predict_end = chrono::steady_clock::now();
+    }
+    statsAccumulator stats = writeStatsReport(scale_test_labels, predictions, L"scale_output.txt", scale_classification);
+    auto report_end = chrono::steady_clock::now();
+
+    ofstream metrics_file(argv[9]);
+    metrics_file << chrono::duration<double>(train_start - load_start).count() << " " 
+        << chrono::duration<double>(predict_start - train_start).count() << " " 
+        << chrono::duration<double>(predict_end - predict_start).count() << " " 
+        << chrono::duration<double>(report_end - predict_end).count() << " " << getPeakMemory() << " " 
+        << (scale_classification ? stats.getAccuracy() : stats.getRMSE()) << "\n";
+    metrics_file.close();
+    if (!metrics_file) {
+        wcerr << L"Error: could not write the metrics file" << endl;
+        exit(-1);
+    }
+
+    return 0;
+}
+
+/*
+* Writes synthetic training data (num_rows rows), testing data (num_test_rows rows) and testing 
+* labels shaped like the template data: every row draws its label from the template's label 
+* distribution (by picking a random template row), then each feature value from the values that 
+* column takes in the template rows with that label. The columns keep their types and values and 
+* the labels stay (imperfectly) predictable from them, while the rows are new. With a feature 
+* multiplier above 1 the template's columns are repeated, each copy drawn independently. The 
+* files are written as they are generated, so any number of rows fits in memory.
+*/
+void generateSyntheticData(vvd& template_data, long long num_rows, long long num_test_rows, int feature_multiplier, unsigned int seed, 
+    string train_path, string test_path, string labels_path)
+{
+    size_t label_idx = template_data[0].size() - 1;
+    map<double, vector<int>> label_rows;
+    for (size_t x = 0; x < template_data.size(); x++) {
+        label_rows[template_data[x][label_idx]].push_back(x);
+    }
+
+    mt19937 data_rng(seed);
+    ofstream train_file(train_path);
+    ofstream test_file(test_path);
+    ofstream labels_file(labels_path);
+    vector<char> buffers[3];
+    ofstream* files[] = { &train_file, &test_file, &labels_file };
+    for (int f = 0; f < 3; f++) {
+        buffers[f].resize(1 << 20);
+        files[f]->rdbuf()->pubsetbuf(buffers[f].data(), buffers[f].size());
+    }
+
+    for (long long x = 0; x < num_rows + num_test_rows; x++) {
+        ofstream& data_file = (x < num_rows) ? train_file : test_file;
+        double label = template_data[data_rng() % template_data.size()][label_idx];
+        vector<int>& rows = label_rows[label];
+        for (int copy = 0; copy < feature_multiplier; copy++) {
+            for (size_t y = 0; y < label_idx; y++) {
+                if (copy > 0 || y > 0) data_file << ",";
+                data_file << template_data[rows[data_rng() % rows.size()]][y];
+            }
+        }
+        if (x < num_rows) {
+            train_file << "," << label << "\n";
+        } else {
+            test_file << "\n";
+            labels_file << label << "\n";
+        }
+    }
+
+    for (int f = 0; f < 3; f++) {
+        files[f]->close();
+        if (!*files[f]) {
+            wcerr << L"Error: could not write the synthetic data files" << endl;
+            exit(-1);
+        }
+    }
+}
+
+/*
+* Returns: - [size_t] the peak resident memory (working set on Windows) of this process in bytes
+*/
+size_t getPeakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    // NOTE: ru_maxrss is in kilobytes on Linux
+    return (size_t) usage.ru_maxrss * 1024;
+#endif
+}
+
+/*
+* Runs a command line through the shell and waits for it.
+*
+* Returns: - [int] the exit code of the command (-1 if it could not be run)
+*/
+int runCommand(string command)
+{
+#ifdef _WIN32
+    // cmd.exe strips the first and last quote of the line, keep the quoted args intact
+    command = "\"" + command + "\"";
+#endif
+    int status = system(command.c_str());
+#ifndef _WIN32
+    if (status != -1 && WIFEXITED(status)) status = WEXITSTATUS(status);
+#endif
+
+    return status;
+}
+
+string quoteArg(string arg)
+{
+    return "\"" + arg + "\"";
+}
+
+/*
+* Looks for "name" or "name=value" among the args and removes it, so the positional args keep 
+* their positions.
+*
+* Returns: - [string] the value of the option, "true" if it has none, or "" if it is not present
+*/
+string extractOption(int& argc, char* argv[], string name)
+{
+    for (int x = 1; x < argc; x++) {
+        string arg(argv[x]);
+        if (arg == name || arg.compare(0, name.size() + 1, name + "=") == 0) {
+            for (int y = x; y < argc - 1; y++) {
+                argv[y] = argv[y + 1];
+            }
+            argc--;
+            return (arg == name) ? "true" : arg.substr(name.size() + 1);
+        }
+    }
+
+    return "";
+}
+
+/*
+* Extracts the tree options of main (see its comment) from the args.
+*/
+treeOptions extractTreeOptions(int& argc, char* argv[])
+{
+    treeOptions options;
+    string max_depth = extractOption(argc, argv, "--max-depth");
+    if (!max_depth.empty()) options.max_depth = strtol(max_depth.c_str(), NULL, 10);
+    options.best_first = !extractOption(argc, argv, "--best-first").empty();
+    string max_leaves = extractOption(argc, argv, "--max-leaves");
+    if (!max_leaves.empty()) options.max_leaves = strtol(max_leaves.c_str(), NULL, 10);
+    string max_bytes = extractOption(argc, argv, "--max-bytes");
+    if (!max_bytes.empty()) options.max_bytes = strtoull(max_bytes.c_str(), NULL, 10);
+    options.multiway_splits = !extractOption(argc, argv, "--multiway").empty();
+    options.extra_trees = !extractOption(argc, argv, "--extra-trees").empty();
+    options.bootstrap = extractOption(argc, argv, "--no-bootstrap").empty();
+    options.collapse_rows = extractOption(argc, argv, "--keep-duplicates").empty();
+    string seed = extractOption(argc, argv, "--seed");
+    if (!seed.empty()) options.seed = strtoul(seed.c_str(), NULL, 10);
+
+    return options;
+}
+
+/*
+* Returns: - [string] the args that extractTreeOptions turns back into the given options, e.g. to 
+*            pass them on to worker processes
+*/
+string getTreeOptionArgs(treeOptions& options)
+{
+    string args = " --seed=" + to_string(options.seed);
+
+    if (options.max_depth >= 0) args += " --max-depth=" + to_string(options.max_depth);
+    if (options.best_first) args += " --best-first";
+    if (options.max_leaves >= 0) args += " --max-leaves=" + to_string(options.max_leaves);
+    if (options.max_bytes > 0) args += " --max-bytes=" + to_string(options.max_bytes);
+    if (options.multiway_splits) args += " --multiway";
+    if (options.extra_trees) args += " --extra-trees";
+    if (!options.bootstrap) args += " --no-bootstrap";
+    if (!options.collapse_rows) args += " --keep-duplicates";
+
+    return args;
+}
+
+/*
+* Shuffles the training data and moves a fifth of it into a validation set, with the labels 
+* split off the same way as the testing data.
+*/
+void splitValidationData(vvd& dataset, vvd& validation_data, vd& validation_labels)
+{
+    mt19937 shuffle_rng(1);
+    shuffle(dataset.begin(), dataset.end(), shuffle_rng);
+
+    size_t num_validation = dataset.size() / 5;
+    for (size_t x = dataset.size() - num_validation; x < dataset.size(); x++) {
+        vd& row = dataset[x];
+        validation_data.push_back(vd(row.begin(), row.end() - 1));
+        validation_labels.push_back(row[row.size() - 1]);
+    }
+    dataset.resize(dataset.size() - num_validation);
+}
+
 bool getBoolArg(char* arg)
 {
 	if (string(arg) == "true" || string(arg) == "True") {
@@ -170,19 +1432,45 @@ vd parseData(string test_labels_csv)
     return extracted_test_labels;
 }
 
+vvd parseDataset(string data_csv)
+{
+    vvd extracted_data;
+    ifstream input_file;
+    string data_string;
+
+    input_file.open(data_csv);
+    if (!input_file) {
+        wcerr << L"Error: Invalid path to data file" << endl;
+        exit(-1);
+    }
+    while (getline(input_file, data_string)) {
+        extracted_data.push_back(parseDataLine(data_string));
+    }
+
+    return extracted_data;
+}
+
 vd parseDataLine(string data)
 {
 	vd parsed_data;
 
-	while ((data.length() != 0) && (data.find(",") != string::npos)) {
-		size_t pos = data.find_first_of(",");
-		string var_val_str = data.substr(0, pos);
-		double var_val = atof(var_val_str.c_str());
-		parsed_data.push_back(var_val);
-		data.erase(0, pos + 1);
-	}
-	double var_val = atof(data.c_str());
-	parsed_data.push_back(var_val);
+	parseDataLine(data, parsed_data);
 
 	return parsed_data;
-}
\ No newline at end of file
+}
+
+/*
+* Parses a csv line into parsed_data, reusing its storage (empty fields read as 0).
+*/
+void parseDataLine(const string& data, vd& parsed_data)
+{
+	parsed_data.clear();
+
+	const char* field = data.c_str();
+	while (true) {
+		parsed_data.push_back(atof(field));
+		field = strchr(field, ',');
+		if (field == NULL) break;
+		field++;
+	}
+}
@@ -5,10 +5,66 @@
 
 #include "DecisionTree.h"
 #include "RandomForest.h"
+#include "CrossValidation.h"
+#include "GradientBoosting.h"
+#include "SparseData.h"
+#include "Scoring.h"
+#include "LookupTable.h"
+#include "CompactForest.h"
+#include "TreeExplainer.h"
+#include "RawData.h"
+#include "CascadeModel.h"
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/wait.h>
+#include <sys/resource.h>
+#endif
 
+int runCrossValidation(int, char*[]);
+int runBoosting(int, char*[]);
+int runSparse(int, char*[]);
+int runShardedTraining(int, char*[]);
+int runShardWorker(int, char*[]);
+int runScoring(int, char*[]);
+int runRawData(int, char*[]);
+int runScaleTest(int, char*[]);
+int runScaleWorker(int, char*[]);
+void generateSyntheticData(vvd&, long long, long long, int, unsigned int, string, string, string);
+size_t getPeakMemory();
+template <typename model>
+statsAccumulator scoreStream(model&, string, string, wstring, bool, size_t, size_t&);
+template <typename model>
+void saveModel(model&, string);
+int runCommand(string);
+string quoteArg(string);
+template <typename model>
+void pruneModel(model&, string, vvd&, vd&, vvd&);
+template <typename model>
+void compileLookupTable(model&, string, vvd&, vvd&);
+void compactModel(randomForest&, vvd&);
+template <typename model>
+void explainModel(model&, string, vvd&);
+void selectForestTrees(randomForest&, string, bool, int, unsigned int, vvd&, vd&, vvd&);
+void buildCascade(randomForest&, string, string, treeOptions, vvd&, vvd&);
+string extractOption(int&, char*[], string);
+treeOptions extractTreeOptions(int&, char*[]);
+string getTreeOptionArgs(treeOptions&);
+void splitValidationData(vvd&, vvd&, vd&);
 bool getBoolArg(char*);
 tuple<vvd, vvd> parseData(string, string);
 vd parseData(string);
+vvd parseDataset(string);
 vd parseDataLine(string);
+void parseDataLine(const string&, vd&);
 
 #endif
\ No newline at end of file